@@ -0,0 +1,177 @@
+#pragma once
+
+#include <ecl/ecl.h>
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace clcxx {
+
+/// Objects are created with new and deleted by their finalizer
+struct HeapAllocation {};
+
+/// Objects live in ECL managed memory and are reclaimed by the GC. Only types
+/// with a non-trivial destructor get a finalizer, which just runs it.
+struct GcAllocation {};
+
+/// Objects are carved out of per-type slabs of SlabSize objects and recycled
+/// through a free list when finalized. Slabs are never returned to the system.
+template <std::size_t SlabSize = 256> struct SlabAllocation {
+  static_assert(SlabSize > 0, "Slabs must hold at least one object");
+};
+
+/// Allocation policy of the objects of a wrapped type owned by lisp, e.g.
+/// template <> struct allocation_policy<Point> {
+///   typedef SlabAllocation<> type;
+/// };
+/// By default objects go to GC memory, unless they are over-aligned.
+template <typename T> struct allocation_policy {
+  typedef typename std::conditional<alignof(T) <= alignof(std::max_align_t),
+                                    GcAllocation, HeapAllocation>::type type;
+};
+
+/// True if objects of T hold no pointers to GC memory, so their storage need
+/// not be scanned by the collector. Specialize for pointer-free classes.
+template <typename T> struct pointer_free {
+  static constexpr bool value =
+      std::is_arithmetic<T>::value || std::is_enum<T>::value;
+};
+
+namespace detail {
+
+/// Fixed size object pool for type T, shared by all the objects of that type
+template <typename T, std::size_t SlabSize> class Slab {
+public:
+  static Slab &instance() {
+    // never destroyed: finalizers may still run during exit
+    static Slab *p_slab = new Slab();
+    return *p_slab;
+  }
+
+  void *allocate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free == nullptr) {
+      grow();
+    }
+    Node *node = m_free;
+    m_free = node->next;
+    return node;
+  }
+
+  void deallocate(void *p) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Node *node = static_cast<Node *>(p);
+    node->next = m_free;
+    m_free = node;
+  }
+
+private:
+  union Node {
+    Node *next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+  static_assert(alignof(Node) <= alignof(std::max_align_t),
+                "Over-aligned types can not use slab allocation");
+
+  Slab() = default;
+
+  void grow() {
+    Node *block = static_cast<Node *>(::operator new(sizeof(Node) * SlabSize));
+    m_blocks.push_back(block);
+    for (std::size_t i = SlabSize; i-- > 0;) {
+      block[i].next = m_free;
+      m_free = &block[i];
+    }
+  }
+
+  std::mutex m_mutex;
+  Node *m_free = nullptr;
+  std::vector<Node *> m_blocks;
+};
+
+/// Construction and destruction of wrapped objects according to the policy
+template <typename T, typename Policy = typename allocation_policy<T>::type>
+struct Allocator;
+
+template <typename T> struct Allocator<T, HeapAllocation> {
+  static constexpr bool needs_finalizer = true;
+  /// Bytes of each object allocated in GC memory
+  static constexpr std::size_t gc_bytes = 0;
+
+  template <typename... ArgsT> static T *construct(ArgsT &&... args) {
+    return new T(std::forward<ArgsT>(args)...);
+  }
+
+  /// Construct from the object returned by make, elided into the storage
+  template <typename MakeT> static T *emplace(MakeT &&make) {
+    return new T(make());
+  }
+
+  static void destroy(T *p) { delete p; }
+};
+
+template <typename T, std::size_t SlabSize>
+struct Allocator<T, SlabAllocation<SlabSize>> {
+  typedef Slab<T, SlabSize> slab_type;
+  static constexpr bool needs_finalizer = true;
+  static constexpr std::size_t gc_bytes = 0;
+
+  template <typename... ArgsT> static T *construct(ArgsT &&... args) {
+    void *mem = slab_type::instance().allocate();
+    try {
+      return new (mem) T(std::forward<ArgsT>(args)...);
+    } catch (...) {
+      slab_type::instance().deallocate(mem);
+      throw;
+    }
+  }
+
+  template <typename MakeT> static T *emplace(MakeT &&make) {
+    void *mem = slab_type::instance().allocate();
+    try {
+      return new (mem) T(make());
+    } catch (...) {
+      slab_type::instance().deallocate(mem);
+      throw;
+    }
+  }
+
+  static void destroy(T *p) {
+    p->~T();
+    slab_type::instance().deallocate(p);
+  }
+};
+
+template <typename T> struct Allocator<T, GcAllocation> {
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types can not be allocated in GC memory");
+  static constexpr bool needs_finalizer =
+      !std::is_trivially_destructible<T>::value;
+  static constexpr std::size_t gc_bytes = sizeof(T);
+
+  template <typename... ArgsT> static T *construct(ArgsT &&... args) {
+    // on failure the storage is left to the GC
+    return new (allocate()) T(std::forward<ArgsT>(args)...);
+  }
+
+  template <typename MakeT> static T *emplace(MakeT &&make) {
+    return new (allocate()) T(make());
+  }
+
+  /// The memory itself is reclaimed by the GC
+  static void destroy(T *p) { p->~T(); }
+
+private:
+  static void *allocate() {
+    return pointer_free<T>::value ? ecl_alloc_atomic(sizeof(T))
+                                  : ecl_alloc(sizeof(T));
+  }
+};
+
+} // namespace detail
+
+} // namespace clcxx
@@ -1,17 +1,78 @@
 ﻿#pragma once
 
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "type_conversion.hpp"
 
 
 namespace clcxx
 {
 
+namespace detail
+{
+  /// Raw element storage of a lisp array, seen as a C array of PointedT
+  template<typename PointedT>
+  inline PointedT* array_data(cl_object arr)
+  {
+    return reinterpret_cast<PointedT*>(arr->array.self.b8);
+  }
+
+  /// Element type tag of the specialized lisp arrays holding integers
+  template<std::size_t Size, bool Signed> struct IntegerElementType;
+  template<> struct IntegerElementType<1, false> { static constexpr cl_elttype value = ecl_aet_b8; };
+  template<> struct IntegerElementType<1, true> { static constexpr cl_elttype value = ecl_aet_i8; };
+  template<> struct IntegerElementType<2, false> { static constexpr cl_elttype value = ecl_aet_b16; };
+  template<> struct IntegerElementType<2, true> { static constexpr cl_elttype value = ecl_aet_i16; };
+  template<> struct IntegerElementType<4, false> { static constexpr cl_elttype value = ecl_aet_b32; };
+  template<> struct IntegerElementType<4, true> { static constexpr cl_elttype value = ecl_aet_i32; };
+  template<> struct IntegerElementType<8, false> { static constexpr cl_elttype value = ecl_aet_b64; };
+  template<> struct IntegerElementType<8, true> { static constexpr cl_elttype value = ecl_aet_i64; };
+
+  /// Element type tag of the lisp array storing T unboxed
+  template<typename T, typename Enable = void>
+  struct ArrayElementType
+  {
+    static constexpr cl_elttype value = ecl_aet_object;
+  };
+
+  template<typename T>
+  struct ArrayElementType<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+    : IntegerElementType<sizeof(T), std::is_signed<T>::value>
+  {
+  };
+
+  template<> struct ArrayElementType<float> { static constexpr cl_elttype value = ecl_aet_sf; };
+  template<> struct ArrayElementType<double> { static constexpr cl_elttype value = ecl_aet_df; };
+  template<> struct ArrayElementType<long double> { static constexpr cl_elttype value = ecl_aet_lf; };
+
+  /// Type of the elements as stored in the lisp array: numbers are stored
+  /// unboxed in specialized arrays, everything else as cl_object
+  template<typename T>
+  using array_element_t = typename std::conditional<ArrayElementType<T>::value == ecl_aet_object, cl_object, T>::type;
+
+  /// Free the C storage of a lisp owned array
+  inline cl_object free_array_storage(cl_object arr)
+  {
+    std::free(arr->array.self.b8);
+    arr->array.self.b8 = nullptr;
+    return ECL_NIL;
+  }
+}
+
 template<typename PointedT, typename CppT>
 struct ValueExtractor
 {
   inline CppT operator()(PointedT* p)
   {
-    return ConvertToCpp<CppT>(*p);
+    return convert_to_cpp<CppT>(*p);
   }
 };
 
@@ -131,7 +192,7 @@ struct IndexedArrayRef
 
   CppT operator[](const std::size_t i) const
   {
-    return ConvertToCpp<CppT>(ecl_aref1(m_array, i));
+    return convert_to_cpp<CppT>(ecl_aref1(m_array, i));
   }
 
   cl_object m_array;
@@ -146,12 +207,12 @@ struct IndexedArrayRef<ValueT,ValueT>
 
   ValueT& operator[](const std::size_t i)
   {
-    return ((cl_object)m_array->array.self)[i];
+    return detail::array_data<ValueT>(m_array)[i];
   }
 
   ValueT operator[](const std::size_t i) const
   {
-    return ((cl_object)m_array->array.self)[i];
+    return detail::array_data<ValueT>(m_array)[i];
   }
 
   cl_object m_array;
@@ -159,23 +220,29 @@ struct IndexedArrayRef<ValueT,ValueT>
 
 /// Reference a Julia array in an STL-compatible wrapper
 template<typename ValueT, int Dim = 1>
-class ArrayRef : public IndexedArrayRef<mapped_lisp_type<ValueT>, ValueT>
+class ArrayRef : public IndexedArrayRef<detail::array_element_t<ValueT>, ValueT>
 {
 public:
-  ArrayRef(cl_object arr) : IndexedArrayRef<mapped_lisp_type<ValueT>, ValueT>(arr)
+  typedef detail::array_element_t<ValueT> lisp_t;
+
+  ArrayRef(cl_object arr) : IndexedArrayRef<lisp_t, ValueT>(arr)
   {
     assert(wrapped() != nullptr);
+    if(!ECL_ARRAYP(arr) || ecl_array_rank(arr) != Dim ||
+       ecl_array_elttype(arr) != detail::ArrayElementType<ValueT>::value)
+    {
+      throw std::runtime_error("Array of type " + lisp_type_name(cl_type_of(arr)) +
+                               " does not match the element type or rank of the ArrayRef");
+    }
   }
 
   /// Convert from existing C-array (memory owned by C++)
   template<typename... SizesT>
-  ArrayRef(cl_object ptr, const SizesT... sizes);
+  ArrayRef(lisp_t* ptr, const SizesT... sizes);
 
-  /// Convert from existing C-array, explicitly setting Julia ownership
+  /// Convert from existing C-array, explicitly setting Lisp ownership
   template<typename... SizesT>
-  ArrayRef(const bool lisp_owned, cl_object ptr, const SizesT... sizes);
-
-  typedef mapped_lisp_type<ValueT> lisp_t;
+  ArrayRef(const bool lisp_owned, lisp_t* ptr, const SizesT... sizes);
 
   typedef array_iterator_base<lisp_t, ValueT> iterator;
   typedef array_iterator_base<lisp_t const, ValueT const> const_iterator;
@@ -187,44 +254,61 @@ public:
 
   iterator begin()
   {
-    return iterator(static_cast<lisp_t*>(wrapped()->array.self));
+    return iterator(detail::array_data<lisp_t>(wrapped()));
   }
 
   const_iterator begin() const
   {
-    return const_iterator(static_cast<lisp_t*>(wrapped()->array.self));
+    return const_iterator(detail::array_data<lisp_t>(wrapped()));
   }
 
   iterator end()
   {
-    return iterator(static_cast<lisp_t*>(wrapped()->array.self) + (wrapped()->array.dim));
+    return iterator(detail::array_data<lisp_t>(wrapped()) + size());
   }
 
   const_iterator end() const
   {
-    return const_iterator(static_cast<lisp_t*>(wrapped()->array.self) + (wrapped()->array.dim));
+    return const_iterator(detail::array_data<lisp_t>(wrapped()) + size());
   }
 
   void push_back(const ValueT& val)
   {
     static_assert(Dim == 1, "push_back is only for 1D ArrayRef");
     cl_object arr_ptr = wrapped();
-    cl_vector_push_extend(2, arr_ptr, box(val));
+    cl_vector_push_extend(2, box(val), arr_ptr);
   }
 
-  /*const*/ cl_object data() const
+  const lisp_t* data() const
   {
-    return (cl_object)wrapped()->array.self;
+    return detail::array_data<lisp_t>(wrapped());
   }
 
-  cl_object data()
+  lisp_t* data()
   {
-    return (cl_object)wrapped()->array.self;
+    return detail::array_data<lisp_t>(wrapped());
   }
 
+  /// Number of elements, stopping at the fill pointer of vectors that have one
   std::size_t size() const
   {
-    return (wrapped()->array.dim);
+    return Dim == 1 ? wrapped()->vector.fillp : wrapped()->array.dim;
+  }
+
+  /// The array this one is displaced to, or nil. Lisp already resolves the
+  /// storage of a displaced array to the storage of its target plus the
+  /// displacement offset, so data(), begin() and operator[] address the window
+  /// in place and passing a displaced array never copies.
+  cl_object displaced_to() const
+  {
+    return cl_array_displacement(wrapped());
+  }
+
+  /// Index of the first element of this array in the array it is displaced to
+  std::size_t displaced_offset() const
+  {
+    cl_object to = cl_array_displacement(wrapped());
+    return to == ECL_NIL ? 0 : ecl_fixnum(ecl_process_env()->values[1]);
   }
 };
 
@@ -238,36 +322,90 @@ template<typename T, int Dim> struct static_type_mapping<ArrayRef<T, Dim>>
 };
 
 
-// // TODO:
-// template<typename ValueT, typename... SizesT>
-// cl_object wrap_array(const bool lisp_owned, cl_object c_ptr, const SizesT... sizes)
-// {
-//   cl_object dt = static_type_mapping<ArrayRef<ValueT, sizeof...(SizesT)>>::lisp_type();
-//   cl_object dims = nullptr;
-//   dims = convert_to_lisp(std::make_tuple(static_cast<int_t>(sizes)...));
-//   cl_object result = jl_ptr_to_array((cl_object)dt, c_ptr, dims, lisp_owned);
-//   return result;
-// }
-
-// template<typename ValueT, int Dim>
-// template<typename... SizesT>
-// ArrayRef<ValueT, Dim>::ArrayRef(cl_object c_ptr, const SizesT... sizes) : IndexedArrayRef<lisp_t, ValueT>(nullptr)
-// {
-//   IndexedArrayRef<lisp_t, ValueT>::m_array = wrap_array(false, c_ptr, sizes...);
-// }
-
-// template<typename ValueT, int Dim>
-// template<typename... SizesT>
-// ArrayRef<ValueT, Dim>::ArrayRef(const bool lisp_owned, cl_object c_ptr, const SizesT... sizes) : IndexedArrayRef<lisp_t, ValueT>(nullptr)
-// {
-//   IndexedArrayRef<lisp_t, ValueT>::m_array = wrap_array(lisp_owned, c_ptr, sizes...);
-// }
-
-// template<typename ValueT, typename... SizesT>
-// auto make_lisp_array(cl_object c_ptr, const SizesT... sizes) -> ArrayRef<ValueT, sizeof...(SizesT)>
-// {
-//   return ArrayRef<ValueT, sizeof...(SizesT)>(true, c_ptr, sizes...);
-// }
+namespace detail
+{
+  /// Make a lisp array of the given rank, dimensions and element type whose
+  /// storage is c_ptr, see wrap_array
+  inline cl_object wrap_array_storage(const bool lisp_owned, void* c_ptr, const cl_elttype elttype,
+                                      const cl_index* dims, const std::size_t rank)
+  {
+    cl_index total = 1;
+    for(std::size_t i = 0; i != rank; ++i)
+    {
+      total *= dims[i];
+    }
+
+    cl_object result = ecl_alloc_object(rank == 1 ? t_vector : t_array);
+    result->array.elttype = elttype;
+    result->array.flags = 0;
+    result->array.displaced = ECL_NIL;
+    result->array.dim = total;
+    if(rank == 1)
+    {
+      result->vector.fillp = total;
+    }
+    else
+    {
+      result->array.rank = rank;
+      result->array.dims = static_cast<cl_index*>(ecl_alloc_atomic(rank * sizeof(cl_index)));
+      std::memcpy(result->array.dims, dims, rank * sizeof(cl_index));
+    }
+    result->array.self.b8 = static_cast<uint8_t*>(c_ptr);
+    result->array.offset = 0;
+
+    if(lisp_owned)
+    {
+      static cl_object finalizer = nullptr;
+      static const bool rooted = []
+      {
+        // through void (*)(void), which casts to any function type without a
+        // -Wcast-function-type warning
+        finalizer = ecl_make_cfun((cl_objectfn_fixed)(void (*)(void))free_array_storage,
+                                  ECL_NIL, ECL_NIL, 1);
+        ecl_register_root(&finalizer);
+        return true;
+      }();
+      (void)rooted;
+      si_set_finalizer(result, finalizer);
+    }
+    return result;
+  }
+}
+
+/// Make a lisp array of rank sizeof...(SizesT) whose storage is the C array
+/// c_ptr, without copying. Unless lisp_owned is set, the memory stays owned by
+/// C++ and must outlive the array. A lisp owned c_ptr is released with
+/// std::free when the array is collected.
+template<typename ValueT, typename... SizesT>
+cl_object wrap_array(const bool lisp_owned, ValueT* c_ptr, const SizesT... sizes)
+{
+  static_assert(sizeof...(SizesT) != 0, "wrap_array needs at least one dimension");
+  const cl_index dims[] = {static_cast<cl_index>(sizes)...};
+  return detail::wrap_array_storage(lisp_owned, c_ptr, detail::ArrayElementType<ValueT>::value,
+                                    dims, sizeof...(SizesT));
+}
+
+template<typename ValueT, int Dim>
+template<typename... SizesT>
+ArrayRef<ValueT, Dim>::ArrayRef(lisp_t* c_ptr, const SizesT... sizes) : IndexedArrayRef<lisp_t, ValueT>(nullptr)
+{
+  static_assert(sizeof...(SizesT) == Dim, "Number of sizes must match the array rank");
+  IndexedArrayRef<lisp_t, ValueT>::m_array = wrap_array(false, c_ptr, sizes...);
+}
+
+template<typename ValueT, int Dim>
+template<typename... SizesT>
+ArrayRef<ValueT, Dim>::ArrayRef(const bool lisp_owned, lisp_t* c_ptr, const SizesT... sizes) : IndexedArrayRef<lisp_t, ValueT>(nullptr)
+{
+  static_assert(sizeof...(SizesT) == Dim, "Number of sizes must match the array rank");
+  IndexedArrayRef<lisp_t, ValueT>::m_array = wrap_array(lisp_owned, c_ptr, sizes...);
+}
+
+template<typename ValueT, typename... SizesT>
+auto make_lisp_array(ValueT* c_ptr, const SizesT... sizes) -> ArrayRef<ValueT, sizeof...(SizesT)>
+{
+  return ArrayRef<ValueT, sizeof...(SizesT)>(true, c_ptr, sizes...);
+}
 
 template<typename T, int Dim>
 struct ConvertToLisp<ArrayRef<T,Dim>, false>
@@ -288,6 +426,421 @@ struct ConvertToCpp<ArrayRef<T,Dim>, false>
   }
 };
 
+namespace detail
+{
+  /// Check that a fixnum is in the range of the integral type T
+  template<typename T, bool Integral = std::is_integral<T>::value>
+  struct FixnumFits
+  {
+    static bool apply(cl_fixnum) { return true; }
+  };
+
+  template<typename T>
+  struct FixnumFits<T, true>
+  {
+    static bool apply(cl_fixnum v)
+    {
+      if(sizeof(T) >= sizeof(cl_fixnum))
+      {
+        return std::is_signed<T>::value || v >= 0;
+      }
+      return v >= static_cast<cl_fixnum>(std::numeric_limits<T>::min()) &&
+             v <= static_cast<cl_fixnum>(std::numeric_limits<T>::max());
+    }
+  };
+
+  inline bool is_double_float(cl_object x)
+  {
+    return ecl_t_of(x) == t_doublefloat;
+  }
+
+  inline bool is_single_float(cl_object x)
+  {
+    return ecl_t_of(x) == t_singlefloat;
+  }
+
+  /// Name of the lisp type matching an arithmetic type, known statically so
+  /// that error messages don't need a lisp wrapper for T
+  template<typename T>
+  std::string arithmetic_type_name()
+  {
+    if(std::is_same<T, bool>::value)
+    {
+      return "BOOLEAN";
+    }
+    if(std::is_integral<T>::value)
+    {
+      return std::string(std::is_signed<T>::value ? "(SIGNED-BYTE " : "(UNSIGNED-BYTE ") +
+             std::to_string(8 * sizeof(T)) + ")";
+    }
+    if(std::is_same<T, float>::value)
+    {
+      return "SINGLE-FLOAT";
+    }
+    return std::is_same<T, double>::value ? "DOUBLE-FLOAT" : "LONG-FLOAT";
+  }
+
+  template<typename T>
+  void unbox_error(const std::size_t i, cl_object x)
+  {
+    throw std::runtime_error("Element " + std::to_string(i) + " of type " +
+                             lisp_type_name(cl_type_of(x)) + " can't be unboxed to " +
+                             arithmetic_type_name<T>());
+  }
+
+  /// Slow path, for vectors mixing fixnums, floats and other numbers,
+  /// converting the elements from index first on
+  template<typename T>
+  void unbox_mixed(const cl_object* src, const std::size_t first, const std::size_t n, T* out)
+  {
+    for(std::size_t i = first; i != n; ++i)
+    {
+      cl_object x = src[i];
+      if(ECL_FIXNUMP(x))
+      {
+        if(!FixnumFits<T>::apply(ecl_fixnum(x)))
+        {
+          unbox_error<T>(i, x);
+        }
+        out[i] = static_cast<T>(ecl_fixnum(x));
+      }
+      else if(std::is_floating_point<T>::value && is_double_float(x))
+      {
+        out[i] = static_cast<T>(ecl_double_float(x));
+      }
+      else if(std::is_floating_point<T>::value && is_single_float(x))
+      {
+        out[i] = static_cast<T>(ecl_single_float(x));
+      }
+      else if(std::is_floating_point<T>::value && ecl_realp(x))
+      {
+        out[i] = static_cast<T>(ecl_to_long_double(x));
+      }
+      else if(std::is_integral<T>::value && sizeof(T) == 8 && ecl_t_of(x) == t_bignum)
+      {
+        out[i] = std::is_signed<T>::value ? static_cast<T>(ecl_to_int64_t(x))
+                                          : static_cast<T>(ecl_to_uint64_t(x));
+      }
+      else
+      {
+        unbox_error<T>(i, x);
+      }
+    }
+  }
+}
+
+/// Unbox the elements of a general (element-type T) lisp vector into the
+/// contiguous buffer out, which must hold arr.size() elements. The first
+/// element selects a tight loop for fixnums, double-floats or single-floats,
+/// which runs until an element of another kind is met; the rest of the vector
+/// then goes element by element. Each element is read once. Throws on the
+/// first element that can't be converted to T.
+template<typename T>
+void unbox_array(const ArrayRef<cl_object>& arr, T* out)
+{
+  static_assert(std::is_arithmetic<T>::value, "unbox_array needs an arithmetic target type");
+
+  const cl_object* src = arr.data();
+  const std::size_t n = arr.size();
+
+  if(n == 0)
+  {
+    return;
+  }
+  std::size_t i = 0;
+  if(ECL_FIXNUMP(src[0]))
+  {
+    for(; i != n && ECL_FIXNUMP(src[i]) && detail::FixnumFits<T>::apply(ecl_fixnum(src[i])); ++i)
+    {
+      out[i] = static_cast<T>(ecl_fixnum(src[i]));
+    }
+  }
+  else if(std::is_floating_point<T>::value && detail::is_double_float(src[0]))
+  {
+    for(; i != n && detail::is_double_float(src[i]); ++i)
+    {
+      out[i] = static_cast<T>(ecl_double_float(src[i]));
+    }
+  }
+  else if(std::is_floating_point<T>::value && detail::is_single_float(src[0]))
+  {
+    for(; i != n && detail::is_single_float(src[i]); ++i)
+    {
+      out[i] = static_cast<T>(ecl_single_float(src[i]));
+    }
+  }
+
+  detail::unbox_mixed(src, i, n, out);
+}
+
+/// Unbox a general lisp vector into a new std::vector, see unbox_array
+template<typename T>
+std::vector<T> unbox_vector(const ArrayRef<cl_object>& arr)
+{
+  std::vector<T> result(arr.size());
+  unbox_array(arr, result.data());
+  return result;
+}
+
+// Vectors specialized on the element type of T are copied with a memcpy of
+// their storage, general vectors are unboxed element by element
+template<typename T>
+struct ConvertToCpp<std::vector<T>, false, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+  std::vector<T> operator()(cl_object arr) const
+  {
+    if(detail::ArrayElementType<T>::value != ecl_aet_object && ECL_VECTORP(arr) &&
+       ecl_array_elttype(arr) == detail::ArrayElementType<T>::value)
+    {
+      const ArrayRef<T> unboxed(arr);
+      std::vector<T> result(unboxed.size());
+      if(!result.empty())
+      {
+        std::memcpy(result.data(), unboxed.data(), result.size() * sizeof(T));
+      }
+      return result;
+    }
+    return unbox_vector<T>(ArrayRef<cl_object>(arr));
+  }
+};
+
+/// Pointer and length of a run of bytes. Converting from lisp gives a view
+/// into the storage of an (unsigned-byte 8) vector, valid as long as the vector
+/// is, converting to lisp copies the bytes into a new vector.
+struct ByteSpan
+{
+  const uint8_t* data;
+  std::size_t size;
+};
+
+namespace detail
+{
+  inline bool is_byte_vector(cl_object v)
+  {
+    return ecl_t_of(v) == t_vector && v->vector.elttype == ecl_aet_b8;
+  }
+
+  inline cl_object check_bit_vector(cl_object v)
+  {
+    if(ecl_t_of(v) != t_bitvector)
+    {
+      throw std::runtime_error("Expected a bit-vector but got a " + lisp_type_name(cl_type_of(v)));
+    }
+    return v;
+  }
+
+  inline cl_object make_byte_vector(const uint8_t* data, const std::size_t n)
+  {
+    cl_object result = ecl_alloc_simple_vector(n, ecl_aet_b8);
+    std::memcpy(result->vector.self.b8, data, n);
+    return result;
+  }
+
+  /// Reverse the order of the bits inside each byte of w. Lisp bit-vectors
+  /// store bit 0 in the most significant bit of the first byte, while we pack
+  /// words least significant bit first.
+  inline uint64_t reverse_byte_bits(uint64_t w)
+  {
+    w = ((w & 0xF0F0F0F0F0F0F0F0ull) >> 4) | ((w & 0x0F0F0F0F0F0F0F0Full) << 4);
+    w = ((w & 0xCCCCCCCCCCCCCCCCull) >> 2) | ((w & 0x3333333333333333ull) << 2);
+    w = ((w & 0xAAAAAAAAAAAAAAAAull) >> 1) | ((w & 0x5555555555555555ull) << 1);
+    return w;
+  }
+
+  /// Store up to 64 bits, least significant first, at bit position i of the
+  /// (non displaced) bit-vector storage
+  inline void store_bit_word(byte* dest, const std::size_t i, uint64_t w, const std::size_t nbits)
+  {
+    w = reverse_byte_bits(w);
+    for(std::size_t k = 0; k * 8 < nbits; ++k)
+    {
+      dest[i / 8 + k] = static_cast<byte>(w >> (8 * k));
+    }
+  }
+
+  /// Load up to 64 bits starting at bit position i of a bit-vector, least
+  /// significant first. Whole bytes are copied, shifted when the vector is
+  /// displaced at a bit offset; only a trailing partial byte is read bit by
+  /// bit.
+  inline uint64_t load_bit_word(cl_object v, const std::size_t i, const std::size_t nbits)
+  {
+    const byte* src = v->vector.self.bit;
+    const std::size_t first = i + v->vector.offset;
+    const std::size_t shift = first % 8;
+    const byte* bytes = src + first / 8;
+    const std::size_t nbytes = nbits / 8;
+    uint64_t w = 0;
+    for(std::size_t k = 0; k != nbytes; ++k)
+    {
+      // with a shift, the byte straddles bytes[k] and bytes[k + 1]
+      const unsigned b = shift == 0 ? bytes[k] : (bytes[k] << shift | bytes[k + 1] >> (8 - shift)) & 0xFF;
+      w |= static_cast<uint64_t>(b) << (8 * k);
+    }
+    w = reverse_byte_bits(w);
+    for(std::size_t k = nbytes * 8; k != nbits; ++k)
+    {
+      const std::size_t j = first + k;
+      w |= static_cast<uint64_t>((src[j / 8] >> (7 - j % 8)) & 1) << k;
+    }
+    return w;
+  }
+}
+
+template<> struct static_type_mapping<std::vector<uint8_t>>
+{
+  typedef cl_object type;
+  static cl_object lisp_type() { return ecl_read_from_cstring("(VECTOR (UNSIGNED-BYTE 8))"); }
+};
+
+template<> struct static_type_mapping<ByteSpan>
+{
+  typedef cl_object type;
+  static cl_object lisp_type() { return ecl_read_from_cstring("(VECTOR (UNSIGNED-BYTE 8))"); }
+};
+
+template<> struct static_type_mapping<std::vector<bool>>
+{
+  typedef cl_object type;
+  static cl_object lisp_type() { return ecl_read_from_cstring("BIT-VECTOR"); }
+};
+
+template<std::size_t N> struct static_type_mapping<std::bitset<N>>
+{
+  typedef cl_object type;
+  static cl_object lisp_type()
+  {
+    return ecl_read_from_cstring(("(SIMPLE-BIT-VECTOR " + std::to_string(N) + ")").c_str());
+  }
+};
+
+template<>
+struct ConvertToCpp<ByteSpan, false>
+{
+  ByteSpan operator()(cl_object v) const
+  {
+    if(!detail::is_byte_vector(v))
+    {
+      throw std::runtime_error("Expected an (unsigned-byte 8) vector but got a " + lisp_type_name(cl_type_of(v)));
+    }
+    return ByteSpan{v->vector.self.b8, v->vector.fillp};
+  }
+};
+
+template<>
+struct ConvertToLisp<ByteSpan, false>
+{
+  cl_object operator()(const ByteSpan& span) const
+  {
+    return detail::make_byte_vector(span.data, span.size);
+  }
+};
+
+template<>
+struct ConvertToCpp<std::vector<uint8_t>, false>
+{
+  std::vector<uint8_t> operator()(cl_object v) const
+  {
+    if(!detail::is_byte_vector(v))
+    {
+      return unbox_vector<uint8_t>(ArrayRef<cl_object>(v));
+    }
+    const uint8_t* data = v->vector.self.b8;
+    return std::vector<uint8_t>(data, data + v->vector.fillp);
+  }
+};
+
+template<>
+struct ConvertToLisp<std::vector<uint8_t>, false>
+{
+  cl_object operator()(const std::vector<uint8_t>& bytes) const
+  {
+    return detail::make_byte_vector(bytes.data(), bytes.size());
+  }
+};
+
+template<>
+struct ConvertToCpp<std::vector<bool>, false>
+{
+  std::vector<bool> operator()(cl_object v) const
+  {
+    detail::check_bit_vector(v);
+    const std::size_t n = v->vector.fillp;
+    std::vector<bool> result(n);
+    for(std::size_t i = 0; i < n; i += 64)
+    {
+      const std::size_t nbits = std::min<std::size_t>(64, n - i);
+      const uint64_t w = detail::load_bit_word(v, i, nbits);
+      for(std::size_t k = 0; k != nbits; ++k)
+      {
+        result[i + k] = (w >> k) & 1;
+      }
+    }
+    return result;
+  }
+};
+
+template<>
+struct ConvertToLisp<std::vector<bool>, false>
+{
+  cl_object operator()(const std::vector<bool>& bits) const
+  {
+    const std::size_t n = bits.size();
+    cl_object result = ecl_alloc_simple_vector(n, ecl_aet_bit);
+    for(std::size_t i = 0; i < n; i += 64)
+    {
+      const std::size_t nbits = std::min<std::size_t>(64, n - i);
+      uint64_t w = 0;
+      for(std::size_t k = 0; k != nbits; ++k)
+      {
+        w |= static_cast<uint64_t>(bits[i + k]) << k;
+      }
+      detail::store_bit_word(result->vector.self.bit, i, w, nbits);
+    }
+    return result;
+  }
+};
+
+template<std::size_t N>
+struct ConvertToCpp<std::bitset<N>, false>
+{
+  std::bitset<N> operator()(cl_object v) const
+  {
+    detail::check_bit_vector(v);
+    if(v->vector.fillp != N)
+    {
+      throw std::runtime_error("Expected a bit-vector of length " + std::to_string(N) +
+                               " but got length " + std::to_string(v->vector.fillp));
+    }
+    std::bitset<N> result;
+    for(std::size_t i = N; i > 0;)
+    {
+      const std::size_t nbits = i % 64 == 0 ? 64 : i % 64;
+      i -= nbits;
+      result <<= nbits;
+      result |= std::bitset<N>(detail::load_bit_word(v, i, nbits));
+    }
+    return result;
+  }
+};
+
+template<std::size_t N>
+struct ConvertToLisp<std::bitset<N>, false>
+{
+  cl_object operator()(const std::bitset<N>& bits) const
+  {
+    cl_object result = ecl_alloc_simple_vector(N, ecl_aet_bit);
+    const std::bitset<N> low_word(~0ull);
+    std::bitset<N> rest = bits;
+    for(std::size_t i = 0; i < N; i += 64)
+    {
+      const std::size_t nbits = std::min<std::size_t>(64, N - i);
+      detail::store_bit_word(result->vector.self.bit, i, (rest & low_word).to_ullong(), nbits);
+      rest >>= 64;
+    }
+    return result;
+  }
+};
+
 // Iterator operator implementation
 template<typename L, typename R>
 bool operator!=(const array_iterator_base<L,L>& l, const array_iterator_base<R,R>& r)
@@ -349,5 +902,94 @@ std::ptrdiff_t operator-(const array_iterator_base<T,T>& l, const array_iterator
   return l.ptr() - r.ptr();
 }
 
+/// Strided reference to one field of a contiguous sequence of records,
+/// element i being the field of record i. The records are not copied on the
+/// C++ side, so they must outlive the column and must not be reallocated
+/// while it is in use. ECL arrays have no strides: passing a column to lisp
+/// copies its elements into a new specialized vector. FieldT is const for
+/// columns of const records.
+template<typename FieldT>
+class Column
+{
+public:
+  typedef typename std::conditional<std::is_const<FieldT>::value, const char, char>::type byte_type;
+
+  Column(FieldT* first, const std::size_t size, const std::size_t stride) :
+    m_first(reinterpret_cast<byte_type*>(first)), m_size(size), m_stride(stride)
+  {
+  }
+
+  /// Number of records
+  std::size_t size() const
+  {
+    return m_size;
+  }
+
+  /// Distance between consecutive column elements, in bytes
+  std::size_t stride() const
+  {
+    return m_stride;
+  }
+
+  FieldT& operator[](const std::size_t i) const
+  {
+    return *reinterpret_cast<FieldT*>(m_first + i * m_stride);
+  }
+
+private:
+  byte_type* m_first;
+  std::size_t m_size;
+  std::size_t m_stride;
+};
+
+/// The given field of every record as a column, see Column
+template<typename T, typename FieldT>
+Column<FieldT> column(std::vector<T>& records, FieldT T::*field)
+{
+  static_assert(std::is_same<detail::array_element_t<FieldT>, FieldT>::value,
+                "Columns are only supported for unboxed element types");
+  FieldT* first = records.empty() ? nullptr : &(records.front().*field);
+  return Column<FieldT>(first, records.size(), sizeof(T));
+}
+
+template<typename T, typename FieldT>
+Column<const FieldT> column(const std::vector<T>& records, FieldT T::*field)
+{
+  static_assert(std::is_same<detail::array_element_t<FieldT>, FieldT>::value,
+                "Columns are only supported for unboxed element types");
+  const FieldT* first = records.empty() ? nullptr : &(records.front().*field);
+  return Column<const FieldT>(first, records.size(), sizeof(T));
+}
+
+template<typename FieldT> struct static_type_mapping<Column<FieldT>>
+{
+  typedef cl_object type;
+  static cl_object lisp_type()
+  {
+    return cl_list(2, ecl_make_symbol("VECTOR", "CL"),
+                   static_type_mapping<typename std::remove_const<FieldT>::type>::lisp_type());
+  }
+};
+
+/// Columns are returned as a new specialized vector holding one element per
+/// record, copied from the records
+template<typename FieldT>
+struct ConvertToLisp<Column<FieldT>, false>
+{
+  typedef typename std::remove_const<FieldT>::type ElementT;
+
+  cl_object operator()(const Column<FieldT>& column) const
+  {
+    const std::size_t n = column.size();
+    cl_object result = ecl_alloc_simple_vector(n, detail::ArrayElementType<ElementT>::value);
+    ElementT* out = detail::array_data<ElementT>(result);
+    for(std::size_t i = 0; i != n; ++i)
+    {
+      out[i] = column[i];
+    }
+    return result;
+  }
+};
+
 }
 
@@ -1,27 +1,80 @@
 ﻿#pragma once
 
-#include "type_conversion.hpp"
-#include <vector>
-#include <queue>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <utility>
 
+#include "type_conversion.hpp"
 
 namespace clcxx
 {
 
-// template <typename T>
-// cl_object add_class_member(T value, char name[]){
-//   return cl_list(6,ecl_read_from_cstring(":initform"),
-//           ConvertToLisp<T, IsFundamental(T)>(value)
-//           ecl_read_from_cstring(":name"),
-//           ecl_read_from_cstring(name),
-//           ecl_read_from_cstring(":type"),
-//           static_type_mapping<T>.lisp_type());
-// }
+/// Define a CLOS class from its name, direct superclasses, canonicalized slot
+/// specifications and class options
+CLCXX_API cl_object ecl_defclass(cl_object name, cl_object super,
+                                 cl_object slots, cl_object options);
 
+/// Define the class of a wrapped C++ type. Its instances have a single slot
+/// holding the pointer box, so the pointer is always found in slot 0.
+CLCXX_API cl_object new_datatype(cl_object name, cl_object super);
 
-CLCXX_API cl_object ecl_defclass(char name[], char package[],
-                                 cl_object super, cl_object options,
-                                 std::queue<cl_object> value_name_type);
+namespace detail
+{
 
-} // namespace clcxx
+/// Printed name of a lisp type, usable in a symbol name: (SIGNED-BYTE 32)
+/// becomes SIGNED-BYTE-32 and classes give their name
+CLCXX_API std::string type_parameter_name(cl_object dt);
 
+/// Defer the definition of a template instantiation class until its type is
+/// first needed from C++, or its name is passed to clcxx_instantiate
+CLCXX_API void add_pending_class(std::type_index type, cl_object name,
+                                 std::function<void()> instantiate);
+
+/// Define the pending class with the given name, returns false if none
+CLCXX_API bool instantiate_pending(cl_object name);
+
+/// Record base as a direct base of derived, at the given byte offset. The
+/// bases of base, which must be registered first, become bases of derived.
+/// The offset must not depend on the dynamic type, so virtual bases cannot
+/// be registered; base_offset rejects them at compile time.
+CLCXX_API void register_base(cl_fixnum derived, cl_fixnum base,
+                             std::ptrdiff_t offset);
+
+/// True if a Base pointer can be static_cast back to a Derived pointer,
+/// which is ill-formed when Base is a virtual base of Derived
+template <typename Derived, typename Base, typename = void>
+struct non_virtual_base : std::false_type
+{
+};
+
+template <typename Derived, typename Base>
+struct non_virtual_base<
+    Derived, Base,
+    decltype(static_cast<void>(static_cast<Derived *>(std::declval<Base *>())))>
+    : std::true_type
+{
+};
+
+/// Byte offset of the Base subobject in a Derived. The storage is never
+/// constructed, which is only valid because the offset of a non-virtual base
+/// is fixed at compile time; with a virtual base the conversion would read
+/// the vtable of the uninitialized storage.
+template <typename Derived, typename Base>
+std::ptrdiff_t base_offset()
+{
+  static_assert(std::is_base_of<Base, Derived>::value,
+                "Super class is not a base of the wrapped type");
+  static_assert(non_virtual_base<Derived, Base>::value,
+                "Virtual, ambiguous or inaccessible bases are not supported");
+  typename std::aligned_storage<sizeof(Derived), alignof(Derived)>::type probe;
+  Derived *derived = reinterpret_cast<Derived *>(&probe);
+  Base *base = derived;
+  return reinterpret_cast<char *>(base) - reinterpret_cast<char *>(derived);
+}
+
+} // namespace detail
+
+} // namespace clcxx
@@ -13,8 +13,9 @@
 #include <vector>
 
 // #include "array.hpp"
+#include "gc.hpp"
 #include "package.hpp"
-// #include "smart_pointers.hpp"
+#include "smart_pointers.hpp"
 #include "type_conversion.hpp"
 
 
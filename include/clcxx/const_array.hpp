@@ -1,75 +1,39 @@
-﻿#pragma once
+#pragma once
 
-#include "clcxx.hpp"
-#include "tuple.hpp"
+#include <array>
 
-namespace jlcxx
-{
-
-typedef int_t index_t;
-
-namespace detail
-{
-  // Helper to make a C++ tuple of longs based on the number of elements
-  template<index_t N, typename... TypesT>
-  struct LongNTuple
-  {
-    typedef typename LongNTuple<N-1, index_t, TypesT...>::type type;
-  };
+#include "array.hpp"
+#include "type_conversion.hpp"
 
-  template<typename... TypesT>
-  struct LongNTuple<0, TypesT...>
-  {
-    typedef std::tuple<TypesT...> type;
-  };
-}
-
-/// Wrap a const pointer
-template<typename T>
-struct ConstPtr
+namespace clcxx
 {
-  const T* ptr;
-};
-
-template<typename T> struct IsBits<ConstPtr<T>> : std::true_type {};
 
-template<typename T>
-struct InstantiateParametricType<ConstPtr<T>>
-{
-  int operator()(Module&) const
-  {
-    // Register the Julia type if not already instantiated
-    if(!static_type_mapping<ConstPtr<T>>::has_lisp_type())
-    { // FIXME:
-      jl_datatype_t* dt = (jl_datatype_t*)apply_type((cl_object)lisp_type("ConstPtr"), jl_svec1(static_type_mapping<T>::lisp_type()));
-      set_lisp_type<ConstPtr<T>>(dt);
-      protect_from_gc(dt);
-    }
-    return 0;
-  }
-};
+typedef cl_index index_t;
 
-/// Wrap a pointer, providing the Julia array interface for it
-/// The parameter N represents the number of dimensions
+/// Wrap a const pointer, providing the lisp array interface for it without
+/// copying. The parameter N represents the number of dimensions, the data is
+/// in row-major order. The lisp array made from it is a view on the C++
+/// memory: it must not be written to and must not outlive the data.
 template<typename T, index_t N>
 class ConstArray
 {
 public:
-  typedef typename detail::LongNTuple<N>::type size_t;
+  typedef std::array<index_t, N> dims_type;
 
   template<typename... SizesT>
   ConstArray(const T* ptr, const SizesT... sizes) :
     m_arr(ptr),
-    m_sizes(sizes...)
+    m_sizes{{static_cast<index_t>(sizes)...}}
   {
+    static_assert(sizeof...(SizesT) == N, "Number of sizes must match the array rank");
   }
 
-  T getindex(const int_t i) const
+  T getindex(const index_t i) const
   {
-    return m_arr[i-1];
+    return m_arr[i];
   }
 
-  size_t size() const
+  const dims_type& size() const
   {
     return m_sizes;
   }
@@ -81,12 +45,7 @@ public:
 
 private:
   const T* m_arr;
-  const size_t m_sizes;
-};
-
-template<typename T, index_t N>
-struct InstantiateParametricType<ConstArray<T,N>> : InstantiateParametricType<ConstPtr<T>>
-{
+  const dims_type m_sizes;
 };
 
 template<typename T, typename... SizesT>
@@ -95,20 +54,20 @@ ConstArray<T, sizeof...(SizesT)> make_const_array(const T* p, const SizesT... si
   return ConstArray<T, sizeof...(SizesT)>(p, sizes...);
 }
 
-template<typename T, index_t N> struct IsImmutable<ConstArray<T,N>> : std::true_type {};
-
+// The lisp array displaces the C++ data, which lisp has no way to mark as
+// read-only: the const_cast only satisfies the storage interface, and lisp
+// code receiving a ConstArray must treat the array as read-only. Writing to
+// it is undefined behavior if the data is really const, e.g. in a read-only
+// segment. Copy the data into a lisp array when lisp needs to modify it.
 template<typename T, index_t N>
-struct ConvertToLisp<ConstArray<T,N>, false, true, false>
+struct ConvertToLisp<ConstArray<T,N>, false>
 {
-  cl_object operator()(const ConstArray<T,N>& arr)
+  cl_object operator()(const ConstArray<T,N>& arr) const
   {
-    cl_object result = nullptr;
-    cl_object ptr = nullptr;
-    cl_object size = nullptr;
-    ptr = box(ConstPtr<T>({arr.ptr()}));
-    size = convert_to_lisp(arr.size());
-    result = jl_new_struct(lisp_type<ConstArray<T,N>>(), ptr, size); // FIXME:
-    return result;
+    static_assert(detail::ArrayElementType<T>::value != ecl_aet_object,
+                  "ConstArray needs an element type lisp can store unboxed");
+    return detail::wrap_array_storage(false, const_cast<T*>(arr.ptr()), detail::ArrayElementType<T>::value,
+                                      arr.size().data(), N);
   }
 };
 
@@ -118,18 +77,8 @@ struct static_type_mapping<ConstArray<T,N>>
   typedef cl_object type;
   static cl_object lisp_type()
   {
-    static cl_object app_dt = nullptr;
-    if(app_dt == nullptr)
-    {
-      cl_object pdt = (cl_object)::jlcxx::lisp_type("ConstArray");
-      cl_object boxed_n = box(N);
-      // FIXME: ??
-      app_dt = (cl_object)apply_type((cl_object)pdt, jl_svec2(::jlcxx::lisp_type<T>(), boxed_n));
-      protect_from_gc(app_dt);
-    }
-    return app_dt;
+    return cl_list(3, ecl_read_from_cstring("ARRAY"), ::clcxx::lisp_type<T>(), ecl_make_fixnum(N));
   }
 };
 
-} // namespace jlcxx
-
+} // namespace clcxx
@@ -157,9 +157,9 @@ namespace detail
     typedef R return_type;
     typedef R(*fptr_t)(ArgsT...);
 
-    std::vector<cl_object> operator()()
+    lisp_vector operator()()
     {
-      return std::vector<cl_object>({static_type_mapping<ArgsT>::lisp_type()...});
+      return lisp_vector({static_type_mapping<ArgsT>::lisp_type()...});
     }
 
     fptr_t cast_ptr(void* ptr)
@@ -183,7 +183,7 @@ typename detail::SplitSignature<SignatureT>::fptr_t make_function_pointer(SafeCF
   }
 
   // Check arguments
-  // const std::vector<cl_object> expected_argstypes = SplitterT()();
+  // const lisp_vector expected_argstypes = SplitterT()();
   // ArrayRef<cl_object> argtypes(data.argtypes);
   // const int nb_args = expected_argstypes.size();
   // if(nb_args != static_cast<int>(argtypes.size()))
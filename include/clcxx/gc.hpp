@@ -0,0 +1,326 @@
+#pragma once
+
+#include <ecl/ecl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "clcxx_config.hpp"
+
+namespace clcxx {
+
+/// Index of a lisp object in the GC protection table. The table is a single
+/// uncollectable slot array scanned by the collector, with a free list
+/// threaded through the unused slots, so all operations are O(1).
+typedef std::size_t gc_handle;
+
+/// Protect obj from collection, returning a handle with a reference count of 1
+CLCXX_API gc_handle gc_protect(cl_object obj);
+
+/// Add a reference to a protected object
+CLCXX_API void gc_retain(gc_handle handle);
+
+/// Drop a reference, the slot is freed when the count reaches 0
+CLCXX_API void gc_release(gc_handle handle);
+
+/// The object protected by a handle
+CLCXX_API cl_object gc_get(gc_handle handle);
+
+/// Deferred finalization. When enabled, the finalizers of wrapped objects
+/// only queue them, and their destructors run in batches on the thread that
+/// calls drain_finalization_queue or on the reclamation thread. This keeps
+/// expensive destructors out of the collector's finalization pass.
+CLCXX_API void set_deferred_finalization(bool enabled);
+CLCXX_API bool deferred_finalization();
+
+/// Queue destroy(object) for the next drain. Lock-free, callable from
+/// finalizers on any thread.
+CLCXX_API void defer_destruction(void *object, void (*destroy)(void *));
+
+/// Run the queued destructors in queue order, returning how many ran. A
+/// throwing destructor does not stop the drain: all queued objects are
+/// released, then the first exception is rethrown. The reclamation thread
+/// drops such exceptions.
+CLCXX_API std::size_t drain_finalization_queue();
+
+/// Start a thread draining the queue every period, registered with ECL so
+/// destructors may call into lisp. Enables deferred finalization.
+CLCXX_API void
+start_reclamation_thread(std::chrono::milliseconds period =
+                             std::chrono::milliseconds(10));
+
+/// Stop the reclamation thread, restore the deferred finalization mode in
+/// effect when it was started, and drain the queue a last time on the
+/// calling thread. Without a drain loop, objects queued in deferred mode are
+/// only destroyed by explicit calls to drain_finalization_queue.
+CLCXX_API void stop_reclamation_thread();
+
+/// Owning reference from C++ to a lisp object, keeping it alive
+class ProtectedLispRef {
+public:
+  ProtectedLispRef() = default;
+
+  explicit ProtectedLispRef(cl_object obj)
+      : m_handle(gc_protect(obj)), m_valid(true) {}
+
+  ProtectedLispRef(const ProtectedLispRef &other)
+      : m_handle(other.m_handle), m_valid(other.m_valid) {
+    if (m_valid) {
+      gc_retain(m_handle);
+    }
+  }
+
+  ProtectedLispRef(ProtectedLispRef &&other) noexcept
+      : m_handle(other.m_handle), m_valid(other.m_valid) {
+    other.m_valid = false;
+  }
+
+  ProtectedLispRef &operator=(ProtectedLispRef other) noexcept {
+    std::swap(m_handle, other.m_handle);
+    std::swap(m_valid, other.m_valid);
+    return *this;
+  }
+
+  ~ProtectedLispRef() {
+    if (m_valid) {
+      gc_release(m_handle);
+    }
+  }
+
+  /// The referenced object, ECL_NIL for an empty reference
+  cl_object get() const { return m_valid ? gc_get(m_handle) : ECL_NIL; }
+
+  explicit operator bool() const { return m_valid; }
+
+private:
+  gc_handle m_handle = 0;
+  bool m_valid = false;
+};
+
+/// External memory: bytes owned by lisp handles outside of the GC heap. The
+/// collector does not see them, so they are reported to a pacer which
+/// triggers a collection once the GC allocations and the growth of the live
+/// external memory since the last one are large compared to the heap plus
+/// the external memory, as the collector itself does for GC memory. Removed
+/// memory thus delays the next collection. Wrapped objects report the part
+/// of object_size<T> not allocated in GC memory when they are boxed and
+/// finalized.
+CLCXX_API void add_external_memory(std::size_t bytes);
+CLCXX_API void remove_external_memory(std::size_t bytes);
+
+/// Total external memory currently reported
+CLCXX_API std::size_t external_memory();
+
+/// Approximate memory owned by a wrapped object, counted in the per type
+/// statistics and, beyond its GC allocated part, as external memory.
+/// Specialize to include memory the object owns indirectly, e.g. the
+/// buffer of a large matrix.
+template <typename T> struct object_size {
+  static std::size_t bytes(const T &) { return sizeof(T); }
+};
+
+/// Statistics of the lisp owned objects of every wrapped type, as a list
+/// with one property list per type: (:TYPE cpp-name :CLASS lisp-class
+/// :CREATED n :FINALIZED n :DELETED n :GC-RECLAIMED n :LIVE n :BYTES n).
+/// Objects without finalizer (trivially destructible types in GC memory) are
+/// reclaimed by the GC unobserved: they are counted in GC-RECLAIMED as soon
+/// as they are created, and neither in LIVE nor in BYTES.
+CLCXX_API cl_object type_stats_table();
+
+namespace detail {
+/// Counters of one wrapped type, updated with relaxed atomics, so the table
+/// is only an approximate snapshot while objects are created or finalized
+struct TypeStats {
+  std::atomic<std::size_t> created{0};
+  std::atomic<std::size_t> finalized{0};
+  std::atomic<std::size_t> deleted{0};
+  std::atomic<std::size_t> gc_reclaimed{0};
+  std::atomic<std::size_t> bytes{0};
+};
+
+/// Add the counters of a type, named by its mangled name, to the table. They
+/// are never removed.
+CLCXX_API TypeStats &register_type_stats(const char *cpp_name,
+                                         cl_object lisp_class);
+
+/// Set on the current thread while a finalizer runs for an explicit delete
+CLCXX_API bool &explicit_deletion();
+
+/// Record a newly owned box in the innermost disposal scope, if any
+CLCXX_API void track_for_disposal(cl_object box);
+
+/// Postpones the collections triggered by add_external_memory on this thread
+/// while alive, e.g. while holding a lock finalizers may need. A postponed
+/// collection runs when the outermost pause ends.
+class CLCXX_API PacerPause {
+public:
+  PacerPause();
+  ~PacerPause();
+  PacerPause(const PacerPause &) = delete;
+  PacerPause &operator=(const PacerPause &) = delete;
+};
+} // namespace detail
+
+/// Destroy the object held by a wrapped handle now, running its finalizer
+/// even with deferred finalization. The handle is left empty, so the later
+/// finalization is a no-op. Handles not owned by lisp are only detached.
+CLCXX_API void dispose(cl_object handle);
+
+/// Disposal scopes. Every object owned by lisp that is created on this
+/// thread while a scope is open is kept alive until the scope is popped,
+/// and then disposed, most recent first. Objects escaping the scope are
+/// disposed too. Scopes nest. From lisp, pair clcxx_push_disposal_scope and
+/// clcxx_pop_disposal_scope with UNWIND-PROTECT.
+CLCXX_API void push_disposal_scope();
+
+/// Dispose the objects of the innermost scope, returning how many. All of
+/// them are disposed even if a destructor throws, the first error is then
+/// rethrown.
+CLCXX_API std::size_t pop_disposal_scope();
+
+/// Disposal scope for the lifetime of a C++ block. The destructor never
+/// throws and drops destructor errors: call close() to observe them.
+class DisposalScope {
+public:
+  DisposalScope() { push_disposal_scope(); }
+
+  ~DisposalScope() noexcept {
+    if (m_open) {
+      try {
+        pop_disposal_scope();
+      } catch (...) {
+      }
+    }
+  }
+
+  /// Pop the scope now, returning how many objects were disposed
+  std::size_t close() {
+    m_open = false;
+    return pop_disposal_scope();
+  }
+
+  DisposalScope(const DisposalScope &) = delete;
+  DisposalScope &operator=(const DisposalScope &) = delete;
+
+private:
+  bool m_open = true;
+};
+
+/// STL allocator placing elements in uncollectable memory, which the GC
+/// scans, so lisp objects stored in the container stay alive without a
+/// protection handle per element. Meant for containers of cl_object or of
+/// structs holding them. The GC does not move objects, so the stored
+/// pointers remain valid.
+template <typename T> struct gc_allocator {
+  typedef T value_type;
+
+  gc_allocator() = default;
+
+  template <typename U> gc_allocator(const gc_allocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    void *p = ecl_alloc_uncollectable(n * sizeof(T));
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(p);
+  }
+
+  void deallocate(T *p, std::size_t) noexcept { ecl_free_uncollectable(p); }
+};
+
+template <typename T, typename U>
+bool operator==(const gc_allocator<T> &, const gc_allocator<U> &) noexcept {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const gc_allocator<T> &, const gc_allocator<U> &) noexcept {
+  return false;
+}
+
+/// Vector whose storage is scanned by the GC
+template <typename T> using gc_vector = std::vector<T, gc_allocator<T>>;
+
+/// Vector of lisp objects kept alive by the vector itself
+typedef gc_vector<cl_object> lisp_vector;
+
+/// Non-owning reference from C++ to a lisp object. Only the ECL weak pointer
+/// is protected, so the referenced object can still be collected. Immediate
+/// objects (fixnums, characters) are never collected and are held directly.
+class CLCXX_API WeakLispRef {
+public:
+  WeakLispRef() = default;
+
+  explicit WeakLispRef(cl_object obj);
+
+  /// The referenced object, ECL_NIL for an empty or expired reference
+  cl_object get() const;
+
+  /// True once the referenced object has been collected
+  bool expired() const;
+
+  explicit operator bool() const { return static_cast<bool>(m_ref); }
+
+private:
+  ProtectedLispRef m_ref;
+  bool m_immediate = false;
+};
+
+/// C++ interface to a lisp hash table, kept alive by a single protection
+/// handle. Not synchronized.
+class CLCXX_API LispHashTable {
+public:
+  /// A table made with (MAKE-HASH-TABLE :TEST test :WEAKNESS weakness), where
+  /// a NIL weakness gives an ordinary table
+  LispHashTable(cl_object test, cl_object weakness);
+
+  /// Look up key, storing its value and returning true if present
+  bool find(cl_object key, cl_object &value) const;
+
+  /// The value of key, or def when absent
+  cl_object get(cl_object key, cl_object def = ECL_NIL) const;
+
+  void set(cl_object key, cl_object value);
+
+  /// Remove key, returning whether it was present
+  bool erase(cl_object key);
+
+  void clear();
+
+  /// Number of entries, including those whose weak part died since the
+  /// last GC
+  std::size_t size() const;
+
+  /// The underlying lisp hash table
+  cl_object lisp_table() const { return m_table.get(); }
+
+private:
+  ProtectedLispRef m_table;
+};
+
+/// Hash map keyed by lisp object identity which does not keep its keys
+/// alive: an entry disappears once its key is collected. This is an EQ hash
+/// table with :WEAKNESS :KEY, so values are held strongly and a value
+/// referring to its own key keeps the entry alive.
+class CLCXX_API WeakKeyHashMap : public LispHashTable {
+public:
+  WeakKeyHashMap();
+};
+
+/// Hash map whose entries disappear once their value is collected. Keys are
+/// compared with EQL, so integers such as addresses can be used.
+class CLCXX_API WeakValueHashMap : public LispHashTable {
+public:
+  WeakValueHashMap();
+};
+
+} // namespace clcxx
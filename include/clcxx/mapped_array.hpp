@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include "array.hpp"
+#include "type_conversion.hpp"
+
+namespace clcxx {
+
+/// Access pattern hint passed to madvise for the whole mapping
+enum class MapAdvice { normal, sequential, random, will_need };
+
+namespace detail {
+/// Map length bytes of the file at path starting at offset. A length of 0 maps
+/// up to the end of the file, the mapped length is returned through length.
+/// The mapping is private and copy on write: it shares its clean pages with
+/// the page cache and stays writable, since lisp vectors have no read-only
+/// flag and a stray (SETF AREF) must not fault, but writes never reach the
+/// file.
+CLCXX_API void *map_file(const std::string &path, std::size_t offset,
+                         std::size_t &length, MapAdvice advice);
+
+/// Release a mapping made by map_file, given the address it returned
+CLCXX_API void unmap_file(void *data);
+
+/// Lisp function unmapping the storage of an array made by map_file_array
+CLCXX_API cl_object mapped_array_finalizer();
+
+/// Unmaps a mapping unless released, i.e. until its finalizer is installed
+class MappingGuard {
+public:
+  explicit MappingGuard(void *data) : m_data(data) {}
+  ~MappingGuard() {
+    if (m_data != nullptr) {
+      unmap_file(m_data);
+    }
+  }
+  void release() { m_data = nullptr; }
+  MappingGuard(const MappingGuard &) = delete;
+  MappingGuard &operator=(const MappingGuard &) = delete;
+
+private:
+  void *m_data;
+};
+} // namespace detail
+
+/// Map count elements of type T of a file, starting at byte offset, to a
+/// specialized lisp vector whose storage is the mapping itself. A count of 0
+/// maps up to the end of the file. The mapping is released when the vector is
+/// garbage collected. Writes to the vector are private to the process and
+/// are not saved to the file.
+template <typename T>
+ArrayRef<T> map_file_array(const std::string &path, std::size_t offset = 0,
+                           std::size_t count = 0,
+                           MapAdvice advice = MapAdvice::normal) {
+  static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                "Only numeric types can be mapped to a specialized array");
+  if (offset % alignof(T) != 0) {
+    throw std::runtime_error("Offset " + std::to_string(offset) + " in " +
+                             path + " is not aligned for the element type");
+  }
+  std::size_t length = count * sizeof(T);
+  T *data =
+      static_cast<T *>(detail::map_file(path, offset, length, advice));
+  detail::MappingGuard guard(data);
+  ArrayRef<T> result(data, length / sizeof(T));
+  si_set_finalizer(result.wrapped(), detail::mapped_array_finalizer());
+  guard.release();
+  return result;
+}
+
+} // namespace clcxx
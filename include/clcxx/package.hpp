@@ -1,16 +1,21 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <ecl/ecl.h>
 #include <functional>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <typeindex>
 #include <typeinfo>
 #include <vector>
 
 #include "array.hpp"
+#include "class.hpp"
 #include "type_conversion.hpp"
 
 namespace clcxx {
@@ -31,27 +36,26 @@ template <typename R, typename... Args> struct ReturnTypeAdapter {
         reinterpret_cast<const std::function<R(Args...)> *>(functor);
     assert(std_func != nullptr);
     ecl_process_env()->nvalues = 1;
-    return convert_to_lisp(
-        (*std_func)(convert_to_cpp<mapped_reference_type<Args>>(args)...));
+    return convert_result_to_lisp<R>([&]() -> R {
+      return (*std_func)(convert_to_cpp<mapped_reference_type<Args>>(args)...);
+    });
   }
 };
 
 template <typename... Args> struct ReturnTypeAdapter<void, Args...> {
-  inline void operator()(const void *functor, mapped_lisp_type<Args>... args) {
+  inline cl_object operator()(const void *functor,
+                              mapped_lisp_type<Args>... args) {
     auto std_func =
         reinterpret_cast<const std::function<void(Args...)> *>(functor);
     assert(std_func != nullptr);
     (*std_func)(convert_to_cpp<mapped_reference_type<Args>>(args)...);
     ecl_process_env()->nvalues = 0;
+    return ECL_NIL;
   }
 };
 
-template <typename T> cl_object gen_args(int &i) {
-  return ecl_read_from_cstring(std::string("V" + std::to_string(i++)).c_str());
-}
-
 /// Make a vector with the types in the variadic template parameter pack
-template <typename... Args> std::vector<cl_object> argtype_vector() {
+template <typename... Args> lisp_vector argtype_vector() {
   return {lisp_type<dereference_for_mapping<Args>>()...};
 }
 
@@ -72,14 +76,19 @@ template <> struct NeedConvertHelper<> {
 
 } // namespace detail
 
-/// Convenience function to create an object with a finalizer attached
+/// Convenience function to create an object. If finalize is true the object
+/// is owned by lisp and allocated according to the allocation policy of T,
+/// otherwise it is created with new and must be deleted from C++.
 template <typename T, bool finalize = true, typename... ArgsT>
 cl_object create(ArgsT &&... args) {
   cl_object dt = lisp_type<T>();
 
-  T *cpp_obj = new T(std::forward<ArgsT>(args)...);
+  if (!finalize) {
+    return boxed_cpp_pointer(new T(std::forward<ArgsT>(args)...), dt, false);
+  }
+  T *cpp_obj = detail::Allocator<T>::construct(std::forward<ArgsT>(args)...);
 
-  return boxed_cpp_pointer(cpp_obj, dt, finalize);
+  return detail::boxed_new_object(cpp_obj, dt);
 }
 
 /// Registry containing different packages
@@ -133,10 +142,251 @@ template <typename R, typename... Args> struct CallFunctor {
     return return_type();
   }
 };
+
+/// Direct access to a data member. The member pointer is passed from lisp as
+/// a fixnum constant, so no function object is involved. Its representation
+/// must fit in a cl_fixnum, and its value in the fixnum range, which lacks
+/// the tag bits: with the Itanium ABI it is the member offset, or -1.
+template <typename T, typename M> struct FieldAccess {
+  typedef M T::*member_ptr;
+  static_assert(sizeof(member_ptr) <= sizeof(cl_fixnum),
+                "Member pointer does not fit in a fixnum");
+
+  static cl_object encode(member_ptr m) {
+    cl_fixnum bits = 0;
+    std::memcpy(&bits, &m, sizeof(m));
+    if (bits < MOST_NEGATIVE_FIXNUM || bits > MOST_POSITIVE_FIXNUM) {
+      throw std::runtime_error("Member pointer does not fit in a fixnum");
+    }
+    return ecl_make_fixnum(bits);
+  }
+
+  static member_ptr decode(cl_object bits) {
+    const cl_fixnum value = ecl_fixnum(bits);
+    member_ptr m;
+    std::memcpy(&m, &value, sizeof(m));
+    return m;
+  }
+
+  static cl_object get(cl_object member, cl_object obj) {
+    try {
+      ecl_process_env()->nvalues = 1;
+      return convert_to_lisp(checked_wrapped_ptr<T>(obj)->*decode(member));
+    } catch (const std::exception &err) {
+      FEerror(err.what(), 0);
+    }
+    return ECL_NIL;
+  }
+
+  static cl_object set(cl_object member, cl_object value, cl_object obj) {
+    try {
+      checked_wrapped_ptr<T>(obj)->*decode(member) = convert_to_cpp<M>(value);
+      ecl_process_env()->nvalues = 1;
+      return value;
+    } catch (const std::exception &err) {
+      FEerror(err.what(), 0);
+    }
+    return ECL_NIL;
+  }
+};
+
+/// Read several data members at once, returned as multiple values. The member
+/// pointers are passed in a simple vector of fixnums.
+template <typename T, typename... Ms> struct FieldsAccess {
+  static_assert(sizeof...(Ms) > 0, "No fields given");
+  static_assert(sizeof...(Ms) <= ECL_MULTIPLE_VALUES_LIMIT,
+                "Too many fields for multiple values");
+
+  static cl_object get(cl_object members, cl_object obj) {
+    try {
+      const T *ptr = checked_wrapped_ptr<T>(obj);
+      // converting a wrapped object may set the values of the environment,
+      // so they are only filled once every field is converted
+      cl_object values[sizeof...(Ms)];
+      cl_index i = 0;
+      auto dummy = {
+          (values[i] = convert_to_lisp(
+               ptr->*FieldAccess<T, Ms>::decode(members->vector.self.t[i])),
+           ++i)...};
+      (void)dummy;
+      const cl_env_ptr env = ecl_process_env();
+      std::copy(values, values + sizeof...(Ms), env->values);
+      env->nvalues = sizeof...(Ms);
+      return env->values[0];
+    } catch (const std::exception &err) {
+      FEerror(err.what(), 0);
+    }
+    return ECL_NIL;
+  }
+};
 } // namespace detail
 
 template <typename T> class ClassWrapper;
 
+namespace detail {
+/// Name of a template parameter, used to name the class of an instantiation
+template <typename T> struct ParameterName {
+  static std::string get() {
+    return type_parameter_name(static_type_mapping<T>::lisp_type());
+  }
+};
+
+template <typename T, T Val>
+struct ParameterName<std::integral_constant<T, Val>> {
+  static std::string get() { return std::to_string(Val); }
+};
+} // namespace detail
+
+// Encapsulate a list of parameters, using types only
+template <typename... ParametersT> struct ParameterList {
+  static constexpr int nb_parameters = sizeof...(ParametersT);
+
+  /// Suffix naming an instantiation, e.g. -DOUBLE-FLOAT-3
+  static std::string name_suffix() {
+    std::string result;
+    for (const std::string &name :
+         {std::string(), detail::ParameterName<ParametersT>::get()...}) {
+      if (!name.empty()) {
+        result += "-" + name;
+      }
+    }
+    return result;
+  }
+};
+
+// Specialize this to build the correct parameter list, wrapping non-types in
+// integral constants. There is no way to provide a template here that matches
+// all possible combinations of type and non-type arguments
+template <typename T> struct BuildParameterList {
+  typedef ParameterList<> type;
+};
+
+template <typename T>
+using parameter_list = typename BuildParameterList<T>::type;
+
+// Match any combination of types only
+template <template <typename...> class T, typename... ParametersT>
+struct BuildParameterList<T<ParametersT...>> {
+  typedef ParameterList<ParametersT...> type;
+};
+
+// Match any number of int parameters
+template <template <int...> class T, int... ParametersT>
+struct BuildParameterList<T<ParametersT...>> {
+  typedef ParameterList<std::integral_constant<int, ParametersT>...> type;
+};
+
+namespace detail {
+template <typename... Types> struct DoApply;
+
+template <> struct DoApply<> {
+  template <typename WrapperT, typename FunctorT>
+  void operator()(WrapperT &, FunctorT &&, bool) {}
+};
+
+template <typename AppT> struct DoApply<AppT> {
+  template <typename WrapperT, typename FunctorT>
+  void operator()(WrapperT &w, FunctorT &&ftor, bool lazy) {
+    w.template apply<AppT>(std::forward<FunctorT>(ftor), lazy);
+  }
+};
+
+template <typename... Types> struct DoApply<ParameterList<Types...>> {
+  template <typename WrapperT, typename FunctorT>
+  void operator()(WrapperT &w, FunctorT &&ftor, bool lazy) {
+    DoApply<Types...>()(w, std::forward<FunctorT>(ftor), lazy);
+  }
+};
+
+template <typename T1, typename... Types> struct DoApply<T1, Types...> {
+  template <typename WrapperT, typename FunctorT>
+  void operator()(WrapperT &w, FunctorT &&ftor, bool lazy) {
+    DoApply<T1>()(w, std::forward<FunctorT>(ftor), lazy);
+    DoApply<Types...>()(w, std::forward<FunctorT>(ftor), lazy);
+  }
+};
+} // namespace detail
+
+/// Execute a functor on each type
+template <typename... Types> struct ForEachType;
+
+template <> struct ForEachType<> {
+  template <typename FunctorT> void operator()(FunctorT &&) {}
+};
+
+template <typename AppT> struct ForEachType<AppT> {
+  template <typename FunctorT> void operator()(FunctorT &&ftor) {
+#ifdef _MSC_VER
+    ftor.operator()<AppT>();
+#else
+    ftor.template operator()<AppT>();
+#endif
+  }
+};
+
+template <typename... Types> struct ForEachType<ParameterList<Types...>> {
+  template <typename FunctorT> void operator()(FunctorT &&ftor) {
+    ForEachType<Types...>()(std::forward<FunctorT>(ftor));
+  }
+};
+
+template <typename T1, typename... Types> struct ForEachType<T1, Types...> {
+  template <typename FunctorT> void operator()(FunctorT &&ftor) {
+    ForEachType<T1>()(std::forward<FunctorT>(ftor));
+    ForEachType<Types...>()(std::forward<FunctorT>(ftor));
+  }
+};
+
+template <typename T, typename FunctorT> void for_each_type(FunctorT &&f) {
+  ForEachType<T>()(f);
+}
+
+template <typename... Types> struct UnpackedTypeList {};
+
+template <typename ApplyT, typename... TypeLists> struct CombineTypes;
+
+template <typename ApplyT, typename... UnpackedTypes>
+struct CombineTypes<ApplyT, UnpackedTypeList<UnpackedTypes...>> {
+  typedef typename ApplyT::template apply<UnpackedTypes...> type;
+};
+
+template <typename ApplyT, typename... UnpackedTypes, typename... Types,
+          typename... OtherTypeLists>
+struct CombineTypes<ApplyT, UnpackedTypeList<UnpackedTypes...>,
+                    ParameterList<Types...>, OtherTypeLists...> {
+  typedef CombineTypes<ApplyT, UnpackedTypeList<UnpackedTypes...>,
+                       ParameterList<Types...>, OtherTypeLists...>
+      ThisT;
+
+  template <typename T1> struct type_unpack {
+    typedef UnpackedTypeList<UnpackedTypes..., T1> unpacked_t;
+    typedef CombineTypes<ApplyT, unpacked_t, OtherTypeLists...> combined_t;
+  };
+  typedef ParameterList<
+      typename ThisT::template type_unpack<Types>::combined_t::type...>
+      type;
+};
+
+template <typename ApplyT, typename... Types, typename... OtherTypeLists>
+struct CombineTypes<ApplyT, ParameterList<Types...>, OtherTypeLists...> {
+  typedef CombineTypes<ApplyT, ParameterList<Types...>, OtherTypeLists...>
+      ThisT;
+
+  template <typename T1> struct type_unpack {
+    typedef UnpackedTypeList<T1> unpacked_t;
+    typedef CombineTypes<ApplyT, unpacked_t, OtherTypeLists...> combined_t;
+  };
+
+  typedef ParameterList<
+      typename ThisT::template type_unpack<Types>::combined_t::type...>
+      type;
+};
+
+// Default ApplyT implementation
+template <template <typename...> class TemplateT> struct ApplyType {
+  template <typename... Types> using apply = TemplateT<Types...>;
+};
+
 /// Used to define cfun and init code.
 extern "C" {
   static cl_object Cblock;
@@ -158,25 +408,32 @@ public:
           new const std::function<R(Args...)>(functor));
       registry().functions().push_back(f_ptr);
 
-      cl_object cfun = ecl_make_cfun(
-          (cl_objectfn_fixed)detail::CallFunctor<R, Args...>::apply,
-          ecl_read_from_cstring(std::string(name + "%").c_str()), Cblock,
-          (1 + sizeof...(Args)));
-
-      int i = 0;
-      cl_object args = cl_list(sizeof...(Args), detail::gen_args<Args>(i)...);
-      i = 0;
-      cl_object fun_def = cl_list(
-          4, ecl_make_symbol("DEFUN", "CL-USER"),
-          ecl_read_from_cstring(name.c_str()), args,
-          cl_list((3 + sizeof...(Args)), ecl_make_symbol("FUNCALL", "CL-USER"),
-                  cfun, index, detail::gen_args<Args>(i)...));
-      cl_safe_eval(fun_def, Cnil, OBJNULL);
+      defun_with_data(ecl_read_from_cstring(name.c_str()),
+                      (cl_objectfn_fixed)detail::CallFunctor<R, Args...>::apply,
+                      index, sizeof...(Args));
     } catch (const std::runtime_error &err) {
       FEerror(err.what(), 0);
     }
   }
 
+  /// Define fname (a symbol or a (SETF symbol) list) as a lisp function of
+  /// nargs arguments, calling f with the constant data as first argument
+  void defun_with_data(cl_object fname, cl_objectfn_fixed f, cl_object data,
+                       std::size_t nargs) {
+    cl_object cfun = ecl_make_cfun(f, fname, Cblock, 1 + nargs);
+    cl_object args = ECL_NIL;
+    for (std::size_t i = nargs; i-- > 0;) {
+      args = ecl_cons(
+          ecl_read_from_cstring(std::string("V" + std::to_string(i)).c_str()),
+          args);
+    }
+    cl_object fun_def =
+        cl_list(4, ecl_make_symbol("DEFUN", "CL-USER"), fname, args,
+                cl_listX(4, ecl_make_symbol("FUNCALL", "CL-USER"), cfun, data,
+                         args));
+    cl_safe_eval(fun_def, Cnil, OBJNULL);
+  }
+
   /// Define a new function. Overload for pointers
   template <typename R, typename... Args>
   inline void defun(const std::string &name, R (*f)(Args...),
@@ -203,9 +460,11 @@ public:
     add_lambda(name, std::forward<LambdaT>(lambda), &LambdaT::operator());
   }
 
-  /// Add a composite type
-  template <typename T, typename... super_classes>
-  ClassWrapper<T> defclass(const std::string &name, super_classes... super);
+  /// Add a composite type, backed by a CLOS class. The super classes must
+  /// already be wrapped, and objects of T are then accepted where a super
+  /// class is expected. Virtual inheritance is not supported.
+  template <typename T, typename... SuperClasses>
+  ClassWrapper<T> defclass(const std::string &name);
 
   /// Set a global constant value at the package level
   template <typename T> void defconstant(const std::string &name, T &&value) {
@@ -217,6 +476,10 @@ public:
   cl_object lisp_package() const { return p_cl_pack; }
 
 private:
+  /// Define the class of T with the given list of super classes
+  template <typename T>
+  ClassWrapper<T> add_class(const std::string &name, cl_object super);
+
   template <typename R, typename LambdaT, typename... ArgsT>
   void add_lambda(const std::string &name, LambdaT &&lambda,
                   R (LambdaT::*)(ArgsT...) const) {
@@ -233,16 +496,24 @@ template <typename T> class ClassWrapper {
 public:
   typedef T type;
 
-  // ClassWrapper(Package &pack, jl_datatype_t *dt, jl_datatype_t *ref_dt,
-  //             jl_datatype_t *alloc_dt)
-  //     : p_package(mod), m_dt(dt), m_ref_dt(ref_dt), m_alloc_dt(alloc_dt) {}
-
-  // /// Add a constructor with the given argument types
-  // template <typename... ArgsT>
-  // ClassWrapper<T> &constructor(bool finalize = true) {
-  //   p_package.constructor<T, ArgsT...>(m_dt, finalize);
-  //   return *this;
-  // }
+  ClassWrapper(Package &pack, const std::string &name, cl_object dt)
+      : p_package(pack), p_name(name), p_dt(dt) {}
+
+  /// Add a constructor with the given argument types, named
+  /// CREATE-<class name> by default
+  template <typename... ArgsT>
+  ClassWrapper<T> &constructor(const std::string &name = "",
+                               bool finalize = true) {
+    const std::string fname = name.empty() ? "CREATE-" + p_name : name;
+    if (finalize) {
+      p_package.defun(fname,
+                      [](ArgsT... args) { return create<T, true>(args...); });
+    } else {
+      p_package.defun(fname,
+                      [](ArgsT... args) { return create<T, false>(args...); });
+    }
+    return *this;
+  }
 
   /// Define a member function
   template <typename R, typename CT, typename... ArgsT>
@@ -261,6 +532,69 @@ public:
     return *this;
   }
 
+  /// Add a bulk constructor, named CREATE-<class name>-VECTOR by default. It
+  /// takes one vector per constructor argument, specialized when the argument
+  /// type allows it, and returns a simple-vector of the new objects.
+  template <typename... ArgsT>
+  ClassWrapper<T> &bulk_constructor(const std::string &name = "",
+                                    bool finalize = true) {
+    static_assert(sizeof...(ArgsT) > 0,
+                  "Bulk constructors need at least one argument");
+    const std::string fname =
+        name.empty() ? "CREATE-" + p_name + "-VECTOR" : name;
+    if (finalize) {
+      p_package.defun(fname, [](ArrayRef<remove_const_ref<ArgsT>>... args) {
+        return create_vector<true>(args...);
+      });
+    } else {
+      p_package.defun(fname, [](ArrayRef<remove_const_ref<ArgsT>>... args) {
+        return create_vector<false>(args...);
+      });
+    }
+    return *this;
+  }
+
+  /// Add a function destroying a simple-vector of objects eagerly, named
+  /// DELETE-<class name>-VECTOR by default. The handles are left empty.
+  ClassWrapper<T> &bulk_delete(const std::string &name = "") {
+    const std::string fname =
+        name.empty() ? "DELETE-" + p_name + "-VECTOR" : name;
+    p_package.defun(fname, [](ArrayRef<cl_object> handles) {
+      for (std::size_t i = 0; i != handles.size(); ++i) {
+        detail::destroy_boxed<T>(handles[i]);
+      }
+    });
+    return *this;
+  }
+
+  /// Expose a data member through a reader NAME and, unless the member is
+  /// const, a writer (SETF NAME). Wrapped class members are returned by
+  /// reference.
+  template <typename M>
+  ClassWrapper<T> &field(const std::string &name, M T::*member) {
+    cl_object fname = ecl_read_from_cstring(name.c_str());
+    cl_object data = detail::FieldAccess<T, M>::encode(member);
+    p_package.defun_with_data(
+        fname, (cl_objectfn_fixed)detail::FieldAccess<T, M>::get, data, 1);
+    add_field_setter<M>(
+        fname, data, std::integral_constant<bool, !std::is_const<M>::value>());
+    return *this;
+  }
+
+  /// Define NAME returning the given data members as multiple values
+  template <typename... Ms>
+  ClassWrapper<T> &fields(const std::string &name, Ms T::*... members) {
+    cl_object data = ecl_alloc_simple_vector(sizeof...(Ms), ecl_aet_object);
+    cl_index i = 0;
+    auto dummy = {(data->vector.self.t[i++] =
+                       detail::FieldAccess<T, Ms>::encode(members))...};
+    (void)dummy;
+    p_package.defun_with_data(
+        ecl_read_from_cstring(name.c_str()),
+        (cl_objectfn_fixed)detail::FieldsAccess<T, Ms...>::get, data, 1);
+    return *this;
+  }
+
   /// Define a "member" function using a lambda
   template <typename LambdaT>
   ClassWrapper<T> &method(const std::string &name, LambdaT &&lambda) {
@@ -306,75 +640,130 @@ public:
   //   return *this;
   // }
 
-  // template <typename... AppliedTypesT, typename FunctorT>
-  // ClassWrapper<T> &apply(FunctorT &&apply_ftor) {
-  //   static_assert(detail::IsParametric<T>::value,
-  //                 "Apply can only be called on parametric types");
-  //   auto dummy = {this->template apply_internal<AppliedTypesT>(
-  //       std::forward<FunctorT>(apply_ftor))...};
-  //   return *this;
-  // }
+  /// Wrap the given instantiations of a template. Each one gets its own
+  /// class, named after this one and the template parameters, e.g.
+  /// MATRIX-DOUBLE-FLOAT-3, with this class as super class. The functor is
+  /// called with the ClassWrapper of each instantiation to add its methods.
+  /// If lazy is true, classes are only defined when first needed from C++ or
+  /// by calling clcxx_instantiate on the class name.
+  template <typename... AppliedTypesT, typename FunctorT>
+  ClassWrapper<T> &apply(FunctorT &&apply_ftor, bool lazy = false) {
+    int dummy[] = {0, (this->template apply_internal<AppliedTypesT>(
+                           apply_ftor, lazy),
+                       0)...};
+    (void)dummy;
+    return *this;
+  }
 
   /// Apply all possible combinations of the given types (see example)
   template <template <typename...> class TemplateT, typename... TypeLists,
             typename FunctorT>
-  void apply_combination(FunctorT &&ftor);
+  void apply_combination(FunctorT &&ftor, bool lazy = false) {
+    this->template apply_combination<ApplyType<TemplateT>, TypeLists...>(
+        std::forward<FunctorT>(ftor), lazy);
+  }
 
   template <typename ApplyT, typename... TypeLists, typename FunctorT>
-  void apply_combination(FunctorT &&ftor);
+  void apply_combination(FunctorT &&ftor, bool lazy = false) {
+    typedef typename CombineTypes<ApplyT, TypeLists...>::type applied_list;
+    detail::DoApply<applied_list>()(*this, std::forward<FunctorT>(ftor), lazy);
+  }
 
   // Access to the module
   Package &packule() { return p_package; }
 
-  // jl_datatype_t *dt() { return m_dt; }
+  // The CLOS class of the wrapped type
+  cl_object lisp_class() const { return p_dt; }
 
 private:
-  // template <typename AppliedT, typename FunctorT>
-  // int apply_internal(FunctorT &&apply_ftor) {
-  //   static_assert(parameter_list<AppliedT>::nb_parameters != 0,
-  //                 "No parameters found when applying type. Specialize "
-  //                 "jlcxx::BuildParameterList for your combination of type and "
-  //                 "non-type parameters.");
-  //   static_assert(parameter_list<AppliedT>::nb_parameters >=
-  //                     parameter_list<T>::nb_parameters,
-  //                 "Parametric type applied to wrong number of parameters.");
-  //   const bool is_abstract = jl_is_abstracttype(m_dt);
-
-  //   jl_datatype_t *app_dt = (jl_datatype_t *)apply_type(
-  //       (jl_value_t *)m_dt,
-  //       parameter_list<AppliedT>()(parameter_list<T>::nb_parameters));
-  //   jl_datatype_t *app_ref_dt = (jl_datatype_t *)apply_type(
-  //       (jl_value_t *)m_ref_dt,
-  //       parameter_list<AppliedT>()(parameter_list<T>::nb_parameters));
-  //   jl_datatype_t *app_alloc_dt = (jl_datatype_t *)apply_type(
-  //       (jl_value_t *)m_alloc_dt,
-  //       parameter_list<AppliedT>()(parameter_list<T>::nb_parameters));
-
-  //   set_julia_type<AppliedT>(app_dt);
-  //   p_package.add_default_constructor<AppliedT>(DefaultConstructible<AppliedT>(),
-  //                                              app_dt);
-  //   p_package.add_copy_constructor<AppliedT>(CopyConstructible<AppliedT>(),
-  //                                           app_dt);
-  //   static_type_mapping<AppliedT>::set_reference_type(app_ref_dt);
-  //   static_type_mapping<AppliedT>::set_allocated_type(app_alloc_dt);
-
-  //   apply_ftor(
-  //       ClassWrapper<AppliedT>(p_package, app_dt, app_ref_dt, app_alloc_dt));
-
-  //   p_package.register_type_pair(app_ref_dt, app_alloc_dt);
-
-  //   if (!std::is_same<supertype<AppliedT>, AppliedT>::value) {
-  //     p_package.defun("cxxdowncast", DownCast<AppliedT>::apply);
-  //   }
-
-  //   return 0;
-  // }
+  template <bool finalize, typename... ArgsT>
+  static cl_object create_vector(const ArrayRef<ArgsT> &... args) {
+    std::size_t n = 0;
+    bool first = true;
+    for (const std::size_t size : {args.size()...}) {
+      if (!first && size != n) {
+        throw std::runtime_error("Argument vectors have different lengths");
+      }
+      n = size;
+      first = false;
+    }
+    cl_object result = ecl_alloc_simple_vector(n, ecl_aet_object);
+    std::fill(result->vector.self.t, result->vector.self.t + n, ECL_NIL);
+    for (std::size_t i = 0; i != n; ++i) {
+      result->vector.self.t[i] = create<T, finalize>(args[i]...);
+    }
+    return result;
+  }
+
+  template <typename M>
+  void add_field_setter(cl_object fname, cl_object data, std::true_type) {
+    p_package.defun_with_data(
+        cl_list(2, ecl_make_symbol("SETF", "CL-USER"), fname),
+        (cl_objectfn_fixed)detail::FieldAccess<T, M>::set, data, 2);
+  }
+
+  template <typename M>
+  void add_field_setter(cl_object, cl_object, std::false_type) {}
+
+  template <typename AppliedT, typename FunctorT>
+  void apply_internal(const FunctorT &apply_ftor, bool lazy) {
+    static_assert(parameter_list<AppliedT>::nb_parameters != 0,
+                  "No parameters found when applying type. Specialize "
+                  "clcxx::BuildParameterList for your combination of type "
+                  "and non-type parameters.");
+    const std::string name =
+        p_name + parameter_list<AppliedT>::name_suffix();
+    Package *pack = &p_package;
+    // the class stays reachable through its name, unlike a fresh list
+    cl_object family = p_dt;
+    auto instantiate = [pack, family, name, apply_ftor]() {
+      // names are read in the package, whatever the current one is
+      cl_object current_package = ecl_current_package();
+      si_select_package(pack->lisp_package());
+      try {
+        ClassWrapper<AppliedT> wrapped =
+            pack->template add_class<AppliedT>(name, ecl_list1(family));
+        apply_ftor(wrapped);
+      } catch (...) {
+        si_select_package(current_package);
+        throw;
+      }
+      si_select_package(current_package);
+    };
+    if (lazy) {
+      detail::add_pending_class(std::type_index(typeid(AppliedT)),
+                                ecl_read_from_cstring(name.c_str()),
+                                instantiate);
+    } else {
+      instantiate();
+    }
+  }
+
   Package &p_package;
-  //jl_datatype_t *m_dt;
-  //jl_datatype_t *m_ref_dt;
-  //jl_datatype_t *m_alloc_dt;
+  std::string p_name;
+  cl_object p_dt;
 };
 
+template <typename T>
+ClassWrapper<T> Package::add_class(const std::string &name, cl_object super) {
+  cl_object dt = new_datatype(ecl_read_from_cstring(name.c_str()), super);
+  static_type_mapping<T>::set_lisp_type(dt);
+  return ClassWrapper<T>(*this, name, dt);
+}
+
+template <typename T, typename... SuperClasses>
+ClassWrapper<T> Package::defclass(const std::string &name) {
+  ClassWrapper<T> result = add_class<T>(
+      name, cl_list(sizeof...(SuperClasses), lisp_type<SuperClasses>()...));
+  int dummy[] = {0, (detail::register_base(
+                         ecl_fixnum(type_tag<T>()),
+                         ecl_fixnum(type_tag<SuperClasses>()),
+                         detail::base_offset<T, SuperClasses>()),
+                     0)...};
+  (void)dummy;
+  return result;
+}
+
 } // namespace clcxx
 
 /// Register a new package
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+#include "allocation.hpp"
+#include "type_conversion.hpp"
+
+namespace clcxx {
+
+/// Smart pointers are wrapped like any class returned by value: the smart
+/// pointer itself is stored in the handle storage, with a finalizer dropping
+/// its reference. The handle is an instance of the lisp class of the pointee
+/// and can be passed wherever the pointee, or one of its bases, is expected.
+/// unique_ptr with a stateless deleter is the exception: ownership of the
+/// object itself moves into the handle, see ConvertToLisp below.
+template <typename T> struct IsSmartPointerType : std::false_type {};
+template <typename T>
+struct IsSmartPointerType<std::shared_ptr<T>> : std::true_type {};
+template <typename T, typename D>
+struct IsSmartPointerType<std::unique_ptr<T, D>> : std::true_type {};
+template <typename T>
+struct IsSmartPointerType<std::weak_ptr<T>> : std::true_type {};
+
+/// Raw pointer to the object owned by a smart pointer
+template <typename PtrT> struct DereferenceSmartPointer {
+  static auto apply(PtrT &smart_ptr) -> decltype(smart_ptr.get()) {
+    return smart_ptr.get();
+  }
+};
+
+// std::weak_ptr requires a call to lock(). The object stays owned by its
+// shared pointers, the result is only valid while one of them remains.
+template <typename T> struct DereferenceSmartPointer<std::weak_ptr<T>> {
+  static T *apply(std::weak_ptr<T> &smart_ptr) {
+    return smart_ptr.lock().get();
+  }
+};
+
+// The smart pointers own C++ heap memory only, so their storage is not
+// scanned by the GC
+template <typename T> struct pointer_free<std::shared_ptr<T>> {
+  static constexpr bool value = true;
+};
+
+template <typename T> struct pointer_free<std::weak_ptr<T>> {
+  static constexpr bool value = true;
+};
+
+template <typename T, typename D> struct pointer_free<std::unique_ptr<T, D>> {
+  static constexpr bool value = std::is_empty<D>::value;
+};
+
+namespace detail {
+typedef std::shared_ptr<const void> (*share_function)(void *);
+
+/// Shared ownership of the object held by a smart pointer, if it has any
+template <typename PtrT> struct ShareSmartPointer {
+  static share_function function() { return nullptr; }
+};
+
+template <typename T> struct ShareSmartPointer<std::shared_ptr<T>> {
+  static std::shared_ptr<const void> apply(void *storage) {
+    return *static_cast<std::shared_ptr<T> *>(storage);
+  }
+  static share_function function() { return &apply; }
+};
+
+template <typename T> struct ShareSmartPointer<std::weak_ptr<T>> {
+  static std::shared_ptr<const void> apply(void *storage) {
+    return static_cast<std::weak_ptr<T> *>(storage)->lock();
+  }
+  static share_function function() { return &apply; }
+};
+
+template <typename PtrT> void *dereference_stored(void *storage) {
+  return const_cast<void *>(static_cast<const void *>(
+      DereferenceSmartPointer<PtrT>::apply(*static_cast<PtrT *>(storage))));
+}
+
+/// Lisp class of the handles of a smart pointer to T. The smart pointer
+/// type is registered on first use, before any of its handles exist.
+template <typename PtrT, typename T> cl_object smart_pointer_lisp_type() {
+  typedef typename std::remove_const<T>::type PointeeT;
+  static const bool p_registered = [] {
+    register_smart_pointer(
+        ecl_fixnum(type_tag<PtrT>()),
+        SmartPointerInfo{ecl_fixnum(type_tag<PointeeT>()),
+                         &dereference_stored<PtrT>,
+                         ShareSmartPointer<PtrT>::function()});
+    return true;
+  }();
+  (void)p_registered;
+  return static_type_mapping<PointeeT>::lisp_type();
+}
+
+/// Shared pointer to T from a handle holding a shared or weak pointer to T
+/// or to a class derived from T. NIL gives an empty pointer.
+template <typename T>
+std::shared_ptr<T> shared_from_handle(cl_object lisp_val) {
+  if (lisp_val == ECL_NIL) {
+    return std::shared_ptr<T>();
+  }
+  cl_object box = wrapped_box(lisp_val);
+  typedef std::shared_ptr<typename std::remove_const<T>::type> StoredT;
+  if (box->foreign.tag == type_tag<StoredT>() &&
+      box->foreign.data != nullptr) {
+    return *reinterpret_cast<StoredT *>(box->foreign.data);
+  }
+  const SmartPointerInfo *smart =
+      ECL_FIXNUMP(box->foreign.tag)
+          ? smart_pointer_info(ecl_fixnum(box->foreign.tag))
+          : nullptr;
+  if (smart == nullptr || smart->share == nullptr) {
+    throw std::runtime_error("Object is not a shared pointer to " +
+                             std::string(typeid(T).name()));
+  }
+  if (box->foreign.data == nullptr) {
+    throw std::runtime_error("Shared pointer to " +
+                             std::string(typeid(T).name()) +
+                             " was already deleted");
+  }
+  // aliasing the owner keeps the reference count shared with the handle
+  std::shared_ptr<const void> owner = smart->share(box->foreign.data);
+  return std::shared_ptr<T>(owner, unbox_wrapped_ptr<T>(lisp_val));
+}
+
+/// Deleters without state need no storage: the handle of a unique_ptr<T, D>
+/// then holds the object itself, tagged as a T, and its finalizer applies a
+/// default constructed D
+template <typename T, typename D>
+struct StatelessDeleter
+    : std::integral_constant<
+          bool, std::is_empty<D>::value &&
+                    std::is_default_constructible<D>::value &&
+                    std::is_same<typename std::unique_ptr<T, D>::pointer,
+                                 T *>::value> {};
+
+/// Destruction of the objects owned through a unique_ptr<T, D>
+template <typename T, typename D> struct UniquePtrDeleter {
+  static constexpr std::size_t gc_bytes = 0;
+  static void destroy(void *obj) { D()(static_cast<T *>(obj)); }
+};
+
+template <typename T, typename D>
+cl_object unique_to_lisp(std::unique_ptr<T, D> &ptr, std::true_type) {
+  typedef typename std::remove_const<T>::type NonConstT;
+  if (!ptr) {
+    return ECL_NIL;
+  }
+  NonConstT *cpp_ptr = const_cast<NonConstT *>(ptr.get());
+  cl_object dt = static_type_mapping<NonConstT>::lisp_type();
+  cl_object handle = boxed_cpp_pointer(cpp_ptr, dt, false);
+  cl_object box = wrapped_box(handle);
+  // an identity mapped object may already be owned by its handle
+  if (si_get_finalizer(box) == ECL_NIL) {
+    own_box<NonConstT, UniquePtrDeleter<T, D>>(box, cpp_ptr, dt);
+  }
+  ptr.release();
+  return handle;
+}
+
+template <typename T, typename D>
+cl_object unique_to_lisp(std::unique_ptr<T, D> &ptr, std::false_type) {
+  typedef std::unique_ptr<T, D> PtrT;
+  PtrT *stored =
+      Allocator<PtrT>::emplace([&ptr]() -> PtrT && { return std::move(ptr); });
+  return boxed_new_object(stored, static_type_mapping<PtrT>::lisp_type());
+}
+
+/// Take the ownership of the object held by a handle. Objects created with
+/// new, i.e. boxed by boxed_cpp_pointer or with HeapAllocation, can be taken
+/// by a std::default_delete.
+template <typename T, typename D>
+std::unique_ptr<T, D> unique_from_handle(cl_object lisp_val, std::true_type) {
+  typedef typename std::remove_const<T>::type NonConstT;
+  if (lisp_val == ECL_NIL) {
+    return std::unique_ptr<T, D>();
+  }
+  cl_object box = wrapped_box(lisp_val);
+  if (box->foreign.tag != type_tag<NonConstT>()) {
+    throw std::runtime_error("Object is not a wrapped C++ object of type " +
+                             std::string(typeid(T).name()));
+  }
+  if (box->foreign.data == nullptr) {
+    throw std::runtime_error("C++ object of type " +
+                             std::string(typeid(T).name()) +
+                             " was already deleted");
+  }
+  cl_object fin = si_get_finalizer(box);
+  const bool default_delete = std::is_same<D, std::default_delete<T>>::value;
+  if (fin == finalizer_function<NonConstT, UniquePtrDeleter<T, D>>()) {
+    account_release<NonConstT, UniquePtrDeleter<T, D>>(box, true);
+  } else if (default_delete &&
+             fin == finalizer_function<NonConstT, HeapDeleter<NonConstT>>()) {
+    account_release<NonConstT, HeapDeleter<NonConstT>>(box, true);
+  } else if (default_delete &&
+             std::is_same<typename allocation_policy<NonConstT>::type,
+                          HeapAllocation>::value &&
+             fin == finalizer_function<NonConstT>()) {
+    account_release<NonConstT, PolicyDeleter<NonConstT>>(box, true);
+  } else {
+    throw std::runtime_error("C++ object of type " +
+                             std::string(typeid(T).name()) +
+                             " is not owned by lisp through a unique_ptr");
+  }
+  si_set_finalizer(box, ECL_NIL);
+  T *cpp_ptr = reinterpret_cast<T *>(box->foreign.data);
+  box->foreign.data = nullptr;
+  return std::unique_ptr<T, D>(cpp_ptr);
+}
+
+template <typename T, typename D>
+std::unique_ptr<T, D> unique_from_handle(cl_object lisp_val,
+                                         std::false_type) {
+  if (lisp_val == ECL_NIL) {
+    return std::unique_ptr<T, D>();
+  }
+  return std::move(*checked_wrapped_ptr<std::unique_ptr<T, D>>(lisp_val));
+}
+
+template <typename T, typename D>
+const std::unique_ptr<T, D> &unique_ref_from_handle(cl_object lisp_val,
+                                                   std::false_type) {
+  return *checked_wrapped_ptr<std::unique_ptr<T, D>>(lisp_val);
+}
+
+template <typename T, typename D>
+const std::unique_ptr<T, D> &unique_ref_from_handle(cl_object,
+                                                   std::true_type) {
+  static_assert(!StatelessDeleter<T, D>::value,
+                "The handle holds the object, not a unique_ptr: pass the "
+                "unique_ptr by value to take ownership, or T& to borrow");
+  throw std::logic_error("unreachable");
+}
+} // namespace detail
+
+template <typename T> struct static_type_mapping<std::shared_ptr<T>> {
+  typedef cl_object type;
+  static cl_object lisp_type() {
+    return detail::smart_pointer_lisp_type<std::shared_ptr<T>, T>();
+  }
+};
+
+template <typename T> struct static_type_mapping<std::weak_ptr<T>> {
+  typedef cl_object type;
+  static cl_object lisp_type() {
+    return detail::smart_pointer_lisp_type<std::weak_ptr<T>, T>();
+  }
+};
+
+template <typename T, typename D>
+struct static_type_mapping<std::unique_ptr<T, D>> {
+  typedef cl_object type;
+  static cl_object lisp_type() {
+    return detail::smart_pointer_lisp_type<std::unique_ptr<T, D>, T>();
+  }
+};
+
+// Shared pointers passed by value share ownership with the handle, which may
+// hold a pointer to a derived class
+template <typename T> struct ConvertToCpp<std::shared_ptr<T>, false> {
+  std::shared_ptr<T> operator()(cl_object lisp_val) const {
+    return detail::shared_from_handle<T>(lisp_val);
+  }
+};
+
+// A returned unique_ptr moves its ownership into the handle. With a stateless
+// deleter the handle holds the object itself, so nothing is allocated beyond
+// the object; otherwise the unique_ptr is moved into the handle storage.
+template <typename T, typename D>
+struct ConvertToLisp<std::unique_ptr<T, D>, false> {
+  cl_object operator()(std::unique_ptr<T, D> cpp_val) const {
+    return detail::unique_to_lisp(cpp_val,
+                                  detail::StatelessDeleter<T, D>());
+  }
+};
+
+// Passing a unique_ptr by value moves the ownership out of the handle, which
+// is left empty
+template <typename T, typename D>
+struct ConvertToCpp<std::unique_ptr<T, D>, false> {
+  std::unique_ptr<T, D> operator()(cl_object lisp_val) const {
+    return detail::unique_from_handle<T, D>(lisp_val,
+                                            detail::StatelessDeleter<T, D>());
+  }
+};
+
+// A const reference must not take the ownership
+template <typename T, typename D>
+struct ConvertToCpp<const std::unique_ptr<T, D> &, false> {
+  const std::unique_ptr<T, D> &operator()(cl_object lisp_val) const {
+    return detail::unique_ref_from_handle<T, D>(
+        lisp_val, detail::StatelessDeleter<T, D>());
+  }
+};
+
+// Weak pointers can be made from handles holding shared or weak pointers
+template <typename T> struct ConvertToCpp<std::weak_ptr<T>, false> {
+  std::weak_ptr<T> operator()(cl_object lisp_val) const {
+    return detail::shared_from_handle<T>(lisp_val);
+  }
+};
+
+} // namespace clcxx
@@ -3,15 +3,21 @@
 #include <ecl/ecl.h>
 
 #include <complex>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <typeindex>
 #include <typeinfo>
 
+#include "allocation.hpp"
 #include "clcxx_config.hpp"
+#include "gc.hpp"
 
 namespace clcxx {
 
@@ -20,8 +26,10 @@ inline std::string symbol_name(cl_object sym) {
   return (std::string)(ecl_base_string_pointer_safe(cl_symbol_name(sym)));
 }
 
+// Get the package name
 inline std::string package_name(cl_object p) {
-  return (std::string)(symbol_name(p));
+  return (std::string)(ecl_base_string_pointer_safe(
+      si_copy_to_simple_base_string(cl_package_name(p))));
 }
 
 /// type composite list eg: (complex long-float) (array character 3)
@@ -58,24 +66,173 @@ template <typename CppT> inline CppT unbox(cl_object v) {
   return *reinterpret_cast<CppT *>(&v);
 }
 
-/// Equivalent of the basic C++ type layout in Lisp
-struct WrappedCppPtr {
-  void *voidptr;
-};
+namespace detail {
+/// Allocate the id of a new wrapped type, implemented in clcxx.cpp
+CLCXX_API cl_fixnum new_type_id();
+
+/// Pointer adjustment converting a pointer to the type with id derived into a
+/// pointer to its base with id base. Returns false if base is not a
+/// registered base of derived. Implemented in class.cpp.
+CLCXX_API bool upcast_offset(cl_fixnum derived, cl_fixnum base,
+                             std::ptrdiff_t &offset);
+
+/// Define the class of a lazily applied template instantiation. Returns false
+/// if none is pending for the type. Implemented in class.cpp.
+CLCXX_API bool instantiate_pending(std::type_index type);
+
+/// Access to the object owned by a smart pointer stored in a handle
+struct SmartPointerInfo {
+  /// Type id of the pointee
+  cl_fixnum pointee;
+  /// Pointer to the pointee, from the storage of the smart pointer
+  void *(*get)(void *storage);
+  /// Shared ownership of the pointee, null for unique pointers
+  std::shared_ptr<const void> (*share)(void *storage);
+};
+
+/// Record the smart pointer type with id ptr, so that its handles can be
+/// passed where its pointee is expected. Implemented in class.cpp.
+CLCXX_API void register_smart_pointer(cl_fixnum ptr,
+                                      const SmartPointerInfo &info);
+
+/// The info of a smart pointer type, or null if ptr is not one
+CLCXX_API const SmartPointerInfo *smart_pointer_info(cl_fixnum ptr);
+} // namespace detail
+
+/// Compact id of a C++ type, stored as the fixnum tag of the foreign data
+/// holding pointers to it
+template <typename T> cl_object type_tag() {
+  static const cl_object p_tag = ecl_make_fixnum(detail::new_type_id());
+  return p_tag;
+}
+
+/// Foreign data holding the pointer of a wrapped C++ object. Instances of
+/// wrapped classes keep it in their first (and only) slot.
+inline cl_object wrapped_box(cl_object v) {
+  if (ECL_INSTANCEP(v) && v->instance.length != 0) {
+    v = v->instance.slots[0];
+  }
+  if (ecl_t_of(v) != t_foreign) {
+    throw std::runtime_error("Object is not a wrapped C++ object");
+  }
+  return v;
+}
 
+/// Pointer held by a wrapped object, checking its type tag. Objects of a
+/// registered derived class are adjusted to the base subobject, and handles
+/// holding a smart pointer give its pointee.
 template <typename T> T *unbox_wrapped_ptr(cl_object v) {
-  return reinterpret_cast<T *>(unbox<WrappedCppPtr>(v).voidptr);
+  cl_object box = wrapped_box(v);
+  cl_object tag = type_tag<typename std::remove_const<T>::type>();
+  char *data = static_cast<char *>(box->foreign.data);
+  if (box->foreign.tag == tag) {
+    return reinterpret_cast<T *>(data);
+  }
+  const cl_fixnum from =
+      ECL_FIXNUMP(box->foreign.tag) ? ecl_fixnum(box->foreign.tag) : -1;
+  std::ptrdiff_t offset = 0;
+  if (!detail::upcast_offset(from, ecl_fixnum(tag), offset)) {
+    const detail::SmartPointerInfo *smart =
+        from < 0 ? nullptr : detail::smart_pointer_info(from);
+    if (smart == nullptr ||
+        (smart->pointee != ecl_fixnum(tag) &&
+         !detail::upcast_offset(smart->pointee, ecl_fixnum(tag), offset))) {
+      throw std::runtime_error("Object is not a wrapped C++ object of type " +
+                               std::string(typeid(T).name()));
+    }
+    if (data != nullptr) {
+      data = static_cast<char *>(smart->get(data));
+    }
+  }
+  if (data != nullptr) {
+    data += offset;
+  }
+  return reinterpret_cast<T *>(data);
 }
 
 namespace detail {
-/// Finalizer function for type T
-template <typename T> void finalizer(cl_object to_delete) {
-  T *stored_obj = unbox_wrapped_ptr<T>(to_delete);
+/// Statistics of the lisp owned objects of type T, registered with the class
+/// dt of the first object
+template <typename T> TypeStats &type_stats(cl_object dt) {
+  static TypeStats &p_stats = register_type_stats(typeid(T).name(), dt);
+  return p_stats;
+}
+
+/// Destruction of the lisp owned objects of type T according to their
+/// allocation policy. gc_bytes is the part of each object in GC memory.
+template <typename T> struct PolicyDeleter {
+  static constexpr std::size_t gc_bytes = Allocator<T>::gc_bytes;
+  static void destroy(void *obj) {
+    Allocator<T>::destroy(static_cast<T *>(obj));
+  }
+};
+
+/// Destruction of objects created with new outside of any allocation policy,
+/// e.g. pointers handed to boxed_cpp_pointer by the caller
+template <typename T> struct HeapDeleter {
+  static constexpr std::size_t gc_bytes = 0;
+  static void destroy(void *obj) { delete static_cast<T *>(obj); }
+};
+
+/// Part of the bytes accounted for an object lying outside of the GC heap
+template <typename DeleterT> std::size_t external_bytes(std::size_t bytes) {
+  const std::size_t gc_bytes = DeleterT::gc_bytes;
+  return bytes > gc_bytes ? bytes - gc_bytes : 0;
+}
+
+/// Remove the object held by box from the accounting of lisp owned objects
+template <typename T, typename DeleterT>
+void account_release(cl_object box, bool deleted) {
+  TypeStats &stats = type_stats<T>(ECL_NIL);
+  (deleted ? stats.deleted : stats.finalized)
+      .fetch_add(1, std::memory_order_relaxed);
+  stats.bytes.fetch_sub(box->foreign.size, std::memory_order_relaxed);
+  remove_external_memory(external_bytes<DeleterT>(box->foreign.size));
+}
+
+/// Finalizer function for type T, called on the box holding the pointer.
+/// With deferred finalization the object is only queued, unless it is
+/// deleted explicitly.
+template <typename T, typename DeleterT = PolicyDeleter<T>>
+cl_object finalizer(cl_object to_delete) {
+  T *stored_obj = reinterpret_cast<T *>(to_delete->foreign.data);
+  // cleared first, so the handle is left empty even if the destructor throws
+  to_delete->foreign.data = nullptr;
   if (stored_obj != nullptr) {
-    delete stored_obj;
+    account_release<T, DeleterT>(to_delete, explicit_deletion());
+    if (deferred_finalization() && !explicit_deletion()) {
+      defer_destruction(stored_obj, &DeleterT::destroy);
+    } else {
+      DeleterT::destroy(stored_obj);
+    }
   }
+  return ECL_NIL;
+}
 
-  reinterpret_cast<WrappedCppPtr *>(to_delete)->voidptr = nullptr;
+/// Lisp function running finalizer<T>, shared by all the objects of type T
+template <typename T, typename DeleterT = PolicyDeleter<T>>
+cl_object finalizer_function() {
+  // made and rooted once, even when several threads box their first T
+  static cl_object p_finalizer = nullptr;
+  static const bool p_rooted = [] {
+    p_finalizer = ecl_make_cfun((cl_objectfn_fixed)finalizer<T, DeleterT>,
+                                ECL_NIL, ECL_NIL, 1);
+    ecl_register_root(&p_finalizer);
+    return true;
+  }();
+  (void)p_rooted;
+  return p_finalizer;
+}
+
+/// Pointer of a wrapped object, failing if it has already been deleted
+template <typename T> T *checked_wrapped_ptr(cl_object v) {
+  T *result = unbox_wrapped_ptr<T>(v);
+  if (result == nullptr) {
+    throw std::runtime_error("C++ object of type " +
+                             std::string(typeid(T).name()) +
+                             " was already deleted");
+  }
+  return result;
 }
 template <typename T> struct unused_type {};
 
@@ -95,7 +252,10 @@ using define_if_different = typename DefineIfDifferent<T1, T2>::type;
 template <typename SourceT, bool compound = false> struct static_type_mapping {
   typedef void *type;
   static cl_object lisp_type() {
-    // assert(type_pointer() != nullptr);
+    if (type_pointer() == nullptr) {
+      // lazily applied instantiations are defined on first use
+      detail::instantiate_pending(std::type_index(typeid(SourceT)));
+    }
     if (type_pointer() == nullptr) {
       throw std::runtime_error("Type " + std::string(typeid(SourceT).name()) +
                                " has no lisp wrapper");
@@ -103,6 +263,17 @@ template <typename SourceT, bool compound = false> struct static_type_mapping {
     return type_pointer();
   }
 
+  /// Associate the lisp class created for a wrapped type
+  static void set_lisp_type(cl_object dt) {
+    if (type_pointer() != nullptr) {
+      throw std::runtime_error("Type " + std::string(typeid(SourceT).name()) +
+                               " was already registered");
+    }
+    type_pointer() = dt;
+  }
+
+  static bool has_lisp_type() { return type_pointer() != nullptr; }
+
 private:
   static cl_object &type_pointer() {
     static cl_object m_type_pointer = nullptr;
@@ -149,6 +320,11 @@ template <typename T> struct MappedReferenceType<const T &> {
 template <typename T>
 using mapped_reference_type = typename detail::MappedReferenceType<T>::type;
 
+/// Remove reference and const from a type
+template <typename T>
+using remove_const_ref =
+    typename std::remove_const<typename std::remove_reference<T>::type>::type;
+
 // Needed for Visual C++, static members are different in each DLL
 // Implemented in c_interface.cpp
 extern "C" CLCXX_API cl_object get_cxxwrap_module();
@@ -314,25 +490,133 @@ template <typename T> inline cl_object lisp_type() {
   return static_type_mapping<T>::lisp_type();
 }
 
-/// Wrap a C++ pointer in a lisp type that contains a single void pointer field,
-/// returning the result as an any
-template <typename T>
-cl_object boxed_cpp_pointer(T *cpp_ptr, cl_object dt, bool add_finalizer) {
-  // assert(ecl_to_bool(
-  //     cl_subtypep(2, dt, ecl_read_from_cstring("SI:FOREIGN-DATA"))));
-  // assert((dt)->foreign.tag == ECL_FFI_VOID);
-  cl_object void_ptr = nullptr;
-  cl_object result = nullptr;
-  cl_object finalizer = nullptr;
-  void_ptr = ecl_make_pointer((void *)cpp_ptr);
-  result = void_ptr;
+/// Opt-in identity map for a wrapped type, e.g.
+/// template <> struct identity_mapped<Node> : std::true_type {};
+/// A pointer already exposed to lisp is then always returned as the same
+/// handle, so handles compare EQ and the object is owned at most once. Each
+/// boxing costs a hash table lookup.
+template <typename T> struct identity_mapped : std::false_type {};
+
+namespace detail {
+/// Give lisp the ownership of the object held by box, counting it in the
+/// type statistics with the box size holding its accounted bytes
+template <typename T, typename DeleterT = PolicyDeleter<T>>
+void own_box(cl_object box, T *cpp_ptr, cl_object dt) {
+  si_set_finalizer(box, finalizer_function<T, DeleterT>());
+  track_for_disposal(box);
+  if (cpp_ptr != nullptr) {
+    const std::size_t bytes = object_size<T>::bytes(*cpp_ptr);
+    box->foreign.size = bytes;
+    TypeStats &stats = type_stats<T>(dt);
+    stats.created.fetch_add(1, std::memory_order_relaxed);
+    stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    add_external_memory(external_bytes<DeleterT>(bytes));
+  }
+}
+
+template <typename DeleterT, typename T>
+cl_object new_handle(T *cpp_ptr, cl_object dt, bool add_finalizer) {
+  typedef typename std::remove_const<T>::type NonConstT;
+  cl_object box =
+      ecl_make_foreign_data(type_tag<NonConstT>(), 0, (void *)cpp_ptr);
   if (add_finalizer) {
-    finalizer = ecl_make_pointer((void *)detail::finalizer<T>);
-    si_set_finalizer(result, finalizer);
+    own_box<NonConstT, DeleterT>(box, const_cast<NonConstT *>(cpp_ptr), dt);
   }
+  if (!ECL_INSTANCEP(dt)) {
+    return box;
+  }
+  cl_object result = ecl_allocate_instance(dt, 1);
+  result->instance.slots[0] = box;
+  si_instance_sig_set(result);
   return result;
+}
+
+/// Live handles of an identity mapped type, by object address. Values are
+/// weak, so the table does not keep the handles alive.
+struct IdentityTable {
+  std::mutex mutex;
+  WeakValueHashMap handles;
 };
 
+template <typename T> IdentityTable &identity_table() {
+  // never destroyed, objects may be boxed during exit
+  static IdentityTable *p_table = new IdentityTable();
+  return *p_table;
+}
+
+/// Handle of cpp_ptr, destroyed by DeleterT when add_finalizer is set
+template <typename DeleterT, typename T>
+cl_object handle_for(T *cpp_ptr, cl_object dt, bool add_finalizer,
+                     std::false_type) {
+  return new_handle<DeleterT>(cpp_ptr, dt, add_finalizer);
+}
+
+template <typename DeleterT, typename T>
+cl_object handle_for(T *cpp_ptr, cl_object dt, bool add_finalizer,
+                     std::true_type) {
+  typedef typename std::remove_const<T>::type NonConstT;
+  if (cpp_ptr == nullptr) {
+    return new_handle<DeleterT>(cpp_ptr, dt, add_finalizer);
+  }
+  IdentityTable &table = identity_table<NonConstT>();
+  cl_object key = ecl_make_unsigned_integer(
+      reinterpret_cast<std::uintptr_t>(static_cast<const void *>(cpp_ptr)));
+  // a collection triggered by boxing runs once the lock is released, as the
+  // finalizers it runs may box objects of the same type
+  PacerPause pause;
+  std::lock_guard<std::mutex> lock(table.mutex);
+  cl_object handle = ECL_NIL;
+  // a handle whose object was deleted since may share the address
+  if (table.handles.find(key, handle) &&
+      wrapped_box(handle)->foreign.data == (char *)cpp_ptr) {
+    cl_object box = wrapped_box(handle);
+    if (add_finalizer && si_get_finalizer(box) == ECL_NIL) {
+      own_box<NonConstT, DeleterT>(box, const_cast<NonConstT *>(cpp_ptr), dt);
+    }
+    return handle;
+  }
+  handle = new_handle<DeleterT>(cpp_ptr, dt, add_finalizer);
+  table.handles.set(key, handle);
+  return handle;
+}
+} // namespace detail
+
+/// Wrap a C++ pointer in a foreign data box tagged with the type of T. If dt
+/// is a wrapped class, the result is an instance of it holding the box in its
+/// pointer slot. Lisp owned objects are counted in the type statistics, and
+/// identity mapped types reuse the live handle of the same object. With
+/// add_finalizer, lisp takes the ownership of a pointer created with new.
+template <typename T>
+cl_object boxed_cpp_pointer(T *cpp_ptr, cl_object dt, bool add_finalizer) {
+  typedef typename std::remove_const<T>::type NonConstT;
+  return detail::handle_for<detail::HeapDeleter<NonConstT>>(
+      cpp_ptr, dt, add_finalizer, identity_mapped<NonConstT>());
+}
+
+namespace detail {
+/// Box an object just created by the allocation policy of T, owned by lisp
+/// and released through that policy. Without a finalizer the object is
+/// reclaimed by the GC unobserved, so it is counted as created and reclaimed
+/// at once.
+template <typename T> cl_object boxed_new_object(T *cpp_obj, cl_object dt) {
+  if (!Allocator<T>::needs_finalizer && cpp_obj != nullptr) {
+    TypeStats &stats = type_stats<T>(dt);
+    stats.created.fetch_add(1, std::memory_order_relaxed);
+    stats.gc_reclaimed.fetch_add(1, std::memory_order_relaxed);
+  }
+  return handle_for<PolicyDeleter<T>>(cpp_obj, dt, Allocator<T>::needs_finalizer,
+                                      identity_mapped<T>());
+}
+
+/// Eagerly destroy the object held by a handle of type T (or derived from
+/// T), running and removing its finalizer. The handle is left empty, objects
+/// not owned by lisp are only detached.
+template <typename T> void destroy_boxed(cl_object handle) {
+  unbox_wrapped_ptr<T>(handle);
+  dispose(handle);
+}
+} // namespace detail
+
 // Box an automatically converted value
 template <typename CppT> cl_object box(const CppT &cpp_val) {
   return boxed_cpp_pointer(&cpp_val, static_type_mapping<CppT>::lisp_type(),
@@ -463,18 +747,41 @@ template <typename T> struct IsFundamental {
 };
 
 // to CPP
+// Wrapped C++ classes. The result refers to the object owned by the lisp side,
+// passing it by value copies it.
 template <typename T, bool Fundamental = false, typename Enable = void>
 struct ConvertToCpp {
-  template <typename lispT> T *operator()(lispT &&) const {
-    static_assert(sizeof(T) == 0,
-                  "No appropriate specialization for ConvertToCpp");
-    return nullptr; // not reached
+  T &operator()(cl_object lisp_val) const {
+    return *detail::checked_wrapped_ptr<T>(lisp_val);
+  }
+};
+
+template <typename T> struct ConvertToCpp<T &, false> {
+  T &operator()(cl_object lisp_val) const {
+    return *detail::checked_wrapped_ptr<T>(lisp_val);
+  }
+};
+
+// Const references use the value conversion, which for wrapped classes is
+// itself a reference
+template <typename T> struct ConvertToCpp<const T &, false> {
+  auto operator()(cl_object lisp_val) const
+      -> decltype(ConvertToCpp<T, false>()(lisp_val)) {
+    return ConvertToCpp<T, false>()(lisp_val);
+  }
+};
+
+template <typename T> struct ConvertToCpp<T *, false> {
+  T *operator()(cl_object lisp_val) const {
+    return lisp_val == ECL_NIL ? nullptr : unbox_wrapped_ptr<T>(lisp_val);
   }
 };
 
 // Fundamental type conversion
 template <typename T> struct ConvertToCpp<T, true> {
-  T operator()(cl_object lisp_val) const { return unbox<cl_object>(lisp_val); }
+  remove_const_ref<T> operator()(cl_object lisp_val) const {
+    return unbox<remove_const_ref<T>>(lisp_val);
+  }
 };
 
 // pass-through for cl_object
@@ -506,11 +813,47 @@ struct ConvertToCpp<void *, false> {
 };
 
 // To lisp
+// Wrapped C++ classes returned by value are moved to a new lisp owned object
 template <typename T, bool Fundamental = false, typename Enable = void>
-struct ConvertToLisp;
+struct ConvertToLisp {
+  /// Marks converters able to build the result directly in its storage
+  typedef std::true_type constructs_in_place;
+
+  cl_object operator()(T cpp_val) const {
+    return in_place([&cpp_val]() -> T && { return std::move(cpp_val); });
+  }
+
+  /// Box the object returned by make, which is constructed directly in the
+  /// handle storage when make returns by value
+  template <typename MakeT> static cl_object in_place(MakeT &&make) {
+    T *cpp_obj = detail::Allocator<T>::emplace(std::forward<MakeT>(make));
+    return detail::boxed_new_object(cpp_obj,
+                                    static_type_mapping<T>::lisp_type());
+  }
+};
+
+// References and pointers to wrapped classes are not owned by lisp
+template <typename T> struct ConvertToLisp<T &, false> {
+  cl_object operator()(T &cpp_val) const {
+    return boxed_cpp_pointer(
+        &cpp_val, static_type_mapping<remove_const_ref<T>>::lisp_type(), false);
+  }
+};
+
+template <typename T> struct ConvertToLisp<T *, false> {
+  cl_object operator()(T *cpp_ptr) const {
+    if (cpp_ptr == nullptr) {
+      return ECL_NIL;
+    }
+    return boxed_cpp_pointer(
+        cpp_ptr, static_type_mapping<remove_const_ref<T>>::lisp_type(), false);
+  }
+};
 
 template <typename T> struct ConvertToLisp<T, true> {
-  cl_object operator()(T cpp_val) const { return box<T>(cpp_val); }
+  cl_object operator()(T cpp_val) const {
+    return box<remove_const_ref<T>>(cpp_val);
+  }
 };
 
 template <> struct ConvertToLisp<std::string, false> {
@@ -519,6 +862,18 @@ template <> struct ConvertToLisp<std::string, false> {
   }
 };
 
+template <> struct ConvertToLisp<std::string &, false> {
+  cl_object operator()(const std::string &str) const {
+    return ConvertToLisp<std::string, false>()(str);
+  }
+};
+
+template <> struct ConvertToLisp<const std::string &, false> {
+  cl_object operator()(const std::string &str) const {
+    return ConvertToLisp<std::string, false>()(str);
+  }
+};
+
 template <> struct ConvertToLisp<std::string *, false> {
   cl_object operator()(const std::string *str) const {
     return ConvertToLisp<std::string, false>()(*str);
@@ -558,16 +913,24 @@ template <typename T> struct StrippedConversionType<T *const &> {
 };
 } // namespace detail
 
-/// Remove reference and const from a type
-template <typename T>
-using remove_const_ref =
-    typename std::remove_const<typename std::remove_reference<T>::type>::type;
-
 template <typename T>
 using lisp_converter_type =
     ConvertToLisp<typename detail::StrippedConversionType<T>::type,
                   IsFundamental<remove_const_ref<T>>::value>;
 
+namespace detail {
+template <typename ConverterT, typename = void>
+struct ConstructsInPlace : std::false_type {};
+
+template <typename T> struct VoidType { typedef void type; };
+
+template <typename ConverterT>
+struct ConstructsInPlace<
+    ConverterT,
+    typename VoidType<typename ConverterT::constructs_in_place>::type>
+    : ConverterT::constructs_in_place {};
+} // namespace detail
+
 /// Conversion to the statically mapped target type.
 template <typename T>
 inline auto convert_to_lisp(T &&cpp_val)
@@ -575,41 +938,34 @@ inline auto convert_to_lisp(T &&cpp_val)
   return lisp_converter_type<T>()(std::forward<T>(cpp_val));
 }
 
+template <typename T, typename MakeT>
+inline cl_object convert_result_to_lisp(MakeT &&make, std::true_type) {
+  return lisp_converter_type<T>::in_place(std::forward<MakeT>(make));
+}
+
+template <typename T, typename MakeT>
+inline cl_object convert_result_to_lisp(MakeT &&make, std::false_type) {
+  return convert_to_lisp(make());
+}
+
+/// Convert the result of make, a function returning T. Wrapped classes
+/// returned by value are constructed directly in the storage of the handle.
+template <typename T, typename MakeT>
+inline cl_object convert_result_to_lisp(MakeT &&make) {
+  return convert_result_to_lisp<T>(
+      std::forward<MakeT>(make),
+      detail::ConstructsInPlace<lisp_converter_type<T>>());
+}
+
 template <typename T>
 using cpp_converter_type =
     ConvertToCpp<T, IsFundamental<remove_const_ref<T>>::value>;
 
-/// Conversion to C++
+/// Conversion to C++. Wrapped classes are returned by reference.
 template <typename CppT, typename LispT>
-inline CppT convert_to_cpp(const LispT &lisp_val) {
+inline auto convert_to_cpp(const LispT &lisp_val)
+    -> decltype(cpp_converter_type<CppT>()(lisp_val)) {
   return cpp_converter_type<CppT>()(lisp_val);
 }
 
-// TODO: Generic conversion for C++ classes wrapped in a composite type
-
-// template <typename T>
-// struct CLCXX_API static_type_mapping<T, true> {
-//   typedef class type;
-//   static cl_object lisp_type() {
-//     return ecl_read_from_cstring("STANDARD-OBJECT");
-//   }
-// };
-
-// template <>
-// struct ConvertToCpp<std::string, false> {
-//   std::string operator()(cl_object jstr) const {
-//     return std::string(ConvertToCpp<const char *, false>()(jstr));
-//   }
-// };
-
-// template <typename T>
-// struct ConvertToLisp<T, false, > {
-//   cl_object operator()(T cpp_val) const { return box<T>(cpp_val); }
-// };
-
-// CLCXX_API cl_object ecl_defclass(cl_object name, cl_object package,
-//                                  cl_object super, cl_object options,
-//                                  std::queue<cl_object> slots,
-//                                  std::queue<cl_object> types);
-
 } // namespace clcxx
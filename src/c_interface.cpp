@@ -1,4 +1,5 @@
 ﻿#include "clcxx/array.hpp"
+#include "clcxx/class.hpp"
 #include "clcxx/clcxx.hpp"
 #include "clcxx/clcxx_config.hpp"
 
@@ -36,4 +37,54 @@ CLCXX_API void clcxx_init(cl_object pack_name, cl_object module) {
   }
 }
 
+CLCXX_API cl_object clcxx_instantiate(cl_object class_name) {
+  try {
+    return ecl_make_bool(clcxx::detail::instantiate_pending(class_name));
+  } catch (const std::runtime_error &err) {
+    FEerror(err.what(), 0);
+  }
+  return ECL_NIL;
+}
+
+CLCXX_API cl_object clcxx_drain_finalizers() {
+  try {
+    return ecl_make_unsigned_integer(clcxx::drain_finalization_queue());
+  } catch (const std::runtime_error &err) {
+    FEerror(err.what(), 0);
+  }
+  return ECL_NIL;
+}
+
+CLCXX_API cl_object clcxx_dispose(cl_object handle) {
+  try {
+    clcxx::dispose(handle);
+  } catch (const std::runtime_error &err) {
+    FEerror(err.what(), 0);
+  }
+  return ECL_NIL;
+}
+
+CLCXX_API cl_object clcxx_push_disposal_scope() {
+  clcxx::push_disposal_scope();
+  return ECL_NIL;
+}
+
+CLCXX_API cl_object clcxx_pop_disposal_scope() {
+  try {
+    return ecl_make_unsigned_integer(clcxx::pop_disposal_scope());
+  } catch (const std::runtime_error &err) {
+    FEerror(err.what(), 0);
+  }
+  return ECL_NIL;
+}
+
+CLCXX_API cl_object clcxx_type_stats() {
+  try {
+    return clcxx::type_stats_table();
+  } catch (const std::runtime_error &err) {
+    FEerror(err.what(), 0);
+  }
+  return ECL_NIL;
+}
+
 }
@@ -1,33 +1,269 @@
 #include "clcxx/class.hpp"
 
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace clcxx {
 
+namespace {
+/// Uninterned symbol naming the pointer slot, shared by all wrapped classes
+/// so that subclasses of several of them still have a single slot
+cl_object pointer_slot_name() {
+  static cl_object p_name = nullptr;
+  static const bool p_rooted = [] {
+    p_name = cl_make_symbol(ecl_make_simple_base_string("CXX-POINTER", -1));
+    ecl_register_root(&p_name);
+    return true;
+  }();
+  (void)p_rooted;
+  return p_name;
+}
+/// Values by type id, written under a lock and read without one. Chunks and
+/// published values are never freed, so a reader only needs the acquire loads
+/// matching the release stores of the writer.
+template <typename T> class PublishedTable {
+public:
+  const T *get(cl_fixnum id) const {
+    if (id < 0 || static_cast<std::size_t>(id) >= chunk_size * max_chunks) {
+      return nullptr;
+    }
+    const Chunk *chunk =
+        m_chunks[id / chunk_size].load(std::memory_order_acquire);
+    return chunk == nullptr
+               ? nullptr
+               : chunk->values[id % chunk_size].load(std::memory_order_acquire);
+  }
 
-CLCXX_API cl_object ecl_defclass(char name[], char package[],
-                                 cl_object super, cl_object options,
-                                 std::queue<cl_object> value_name_type){
-  cl_object s = cl_make_array(3,ecl_make_integer(0),ecl_read_from_cstring(":adjustable"),ECL_T);
-  for (auto it = value_name_type.front() ; !value_name_type.empty(); it = value_name_type.front()) {
-    // TODO: chech push order
-    s = cl_vector_push_extend(2,it,s);
-    value_name_type.pop();
+  /// Publish the value of id, the caller holding the writer lock
+  void set(cl_fixnum id, const T *value) {
+    if (id < 0 || static_cast<std::size_t>(id) >= chunk_size * max_chunks) {
+      throw std::runtime_error("Too many registered C++ types");
+    }
+    std::atomic<Chunk *> &slot = m_chunks[id / chunk_size];
+    Chunk *chunk = slot.load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+      chunk = new Chunk();
+      slot.store(chunk, std::memory_order_release);
+    }
+    chunk->values[id % chunk_size].store(value, std::memory_order_release);
   }
-  
-  return clos_load_defclass(
-      ecl_make_symbol(name,package), // ecl_read_from_cstring("MAP"),
-      super,
-      ecl_list1(s),
-      options);
+
+private:
+  static constexpr std::size_t chunk_size = 256;
+  static constexpr std::size_t max_chunks = 4096;
+  struct Chunk {
+    std::atomic<const T *> values[chunk_size];
+  };
+  // zero initialized, the tables only have static storage duration
+  std::atomic<Chunk *> m_chunks[max_chunks];
+};
+
+/// Marks unrelated types in the upcast table
+constexpr std::ptrdiff_t no_offset = PTRDIFF_MIN;
+
+/// rows.get(derived)->at(base) is the offset to add to a derived pointer to
+/// get a base pointer. Registration can happen while handles are unboxed,
+/// e.g. by a lazy template instantiation, so a row is never modified once
+/// published: it is replaced by an updated copy.
+struct UpcastTable {
+  std::mutex mutex;
+  PublishedTable<std::vector<std::ptrdiff_t>> rows;
+};
+
+UpcastTable &upcast_table() {
+  static UpcastTable p_table;
+  return p_table;
+}
+
+/// Called with the lock of the upcast table held
+void set_upcast_offset(UpcastTable &table, cl_fixnum derived, cl_fixnum base,
+                       std::ptrdiff_t offset) {
+  const std::vector<std::ptrdiff_t> *row = table.rows.get(derived);
+  // with repeated (non-virtual) bases, the first path wins
+  if (row != nullptr && static_cast<std::size_t>(base) < row->size() &&
+      (*row)[base] != no_offset) {
+    return;
+  }
+  auto *updated = row == nullptr ? new std::vector<std::ptrdiff_t>()
+                                 : new std::vector<std::ptrdiff_t>(*row);
+  if (updated->size() <= static_cast<std::size_t>(base)) {
+    updated->resize(base + 1, no_offset);
+  }
+  (*updated)[base] = offset;
+  table.rows.set(derived, updated);
+}
+
+/// Smart pointer types by type id, read on every unboxing of a handle that
+/// does not hold exactly the expected type
+struct SmartPointers {
+  std::mutex mutex;
+  PublishedTable<detail::SmartPointerInfo> infos;
+};
+
+SmartPointers &smart_pointers() {
+  static SmartPointers p_smart_pointers;
+  return p_smart_pointers;
 }
+
+/// Instantiation waiting for its first use. Concurrent users wait on once
+/// for a single definition, and a failed one may be retried.
+struct PendingClass {
+  PendingClass(std::type_index type, std::function<void()> instantiate)
+      : type(type), instantiate(std::move(instantiate)) {}
+
+  std::type_index type;
+  std::function<void()> instantiate;
+  std::once_flag once;
+};
+
+/// Lazily applied template instantiations, by C++ type and by class name.
+/// Entries stay until their instantiation succeeds.
+struct PendingClasses {
+  std::mutex mutex;
+  std::map<std::type_index, cl_object> names;
+  std::map<cl_object, std::shared_ptr<PendingClass>> instantiations;
+};
+
+PendingClasses &pending_classes() {
+  static PendingClasses p_pending;
+  return p_pending;
+}
+} // namespace
+
+CLCXX_API cl_object ecl_defclass(cl_object name, cl_object super,
+                                 cl_object slots, cl_object options) {
+  clos_load_defclass(name, super, slots, options);
+  return cl_find_class(1, name);
+}
+
+CLCXX_API cl_object new_datatype(cl_object name, cl_object super) {
+  if (!ECL_SYMBOLP(name)) {
+    throw std::runtime_error("Class name is not a symbol");
+  }
+  cl_object slots =
+      ecl_list1(cl_list(2, ecl_make_keyword("NAME"), pointer_slot_name()));
+  cl_object dt = ecl_defclass(name, super, slots, ECL_NIL);
+  // instances are allocated directly from C++, so the layout must be final
+  cl_funcall(2, ecl_make_symbol("FINALIZE-INHERITANCE", "CLOS"), dt);
+  return dt;
+}
+
+namespace detail {
+
+CLCXX_API void register_base(cl_fixnum derived, cl_fixnum base,
+                             std::ptrdiff_t offset) {
+  UpcastTable &table = upcast_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  set_upcast_offset(table, derived, base, offset);
+  // published rows are immutable, no copy is needed
+  const std::vector<std::ptrdiff_t> *base_row = table.rows.get(base);
+  if (base_row == nullptr) {
+    return;
+  }
+  for (std::size_t i = 0; i < base_row->size(); ++i) {
+    if ((*base_row)[i] != no_offset) {
+      set_upcast_offset(table, derived, i, offset + (*base_row)[i]);
+    }
+  }
+}
+
+CLCXX_API std::string type_parameter_name(cl_object dt) {
+  if (ECL_INSTANCEP(dt)) {
+    dt = cl_funcall(2, ecl_make_symbol("CLASS-NAME", "CL"), dt);
+  }
+  const std::string printed = lisp_string(cl_princ_to_string(dt));
+  std::string result;
+  for (const char c : printed) {
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+      result += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    } else if (!result.empty() && result.back() != '-') {
+      result += '-';
+    }
+  }
+  while (!result.empty() && result.back() == '-') {
+    result.pop_back();
+  }
+  return result;
+}
+
+CLCXX_API void add_pending_class(std::type_index type, cl_object name,
+                                 std::function<void()> instantiate) {
+  PendingClasses &pending = pending_classes();
+  std::lock_guard<std::mutex> lock(pending.mutex);
+  if (!pending.names.emplace(type, name).second) {
+    throw std::runtime_error("Instantiation " + symbol_name(name) +
+                             " was already applied");
+  }
+  pending.instantiations.emplace(
+      name, std::make_shared<PendingClass>(type, std::move(instantiate)));
+}
+
+CLCXX_API bool instantiate_pending(cl_object name) {
+  PendingClasses &pending = pending_classes();
+  std::shared_ptr<PendingClass> entry;
+  {
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    auto it = pending.instantiations.find(name);
+    if (it == pending.instantiations.end()) {
+      return false;
+    }
+    entry = it->second;
+  }
+  // an exception leaves the flag unset and the entry in place
+  std::call_once(entry->once, [&pending, &entry, name]() {
+    entry->instantiate();
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    pending.names.erase(entry->type);
+    pending.instantiations.erase(name);
+  });
+  return true;
+}
+
+CLCXX_API bool instantiate_pending(std::type_index type) {
+  cl_object name = nullptr;
+  {
+    PendingClasses &pending = pending_classes();
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    auto it = pending.names.find(type);
+    if (it == pending.names.end()) {
+      return false;
+    }
+    name = it->second;
+  }
+  return instantiate_pending(name);
+}
+
+CLCXX_API bool upcast_offset(cl_fixnum derived, cl_fixnum base,
+                             std::ptrdiff_t &offset) {
+  const std::vector<std::ptrdiff_t> *row = upcast_table().rows.get(derived);
+  if (row == nullptr || base < 0 ||
+      static_cast<std::size_t>(base) >= row->size() ||
+      (*row)[base] == no_offset) {
+    return false;
+  }
+  offset = (*row)[base];
+  return true;
+}
+
+CLCXX_API void register_smart_pointer(cl_fixnum ptr,
+                                      const SmartPointerInfo &info) {
+  SmartPointers &smart = smart_pointers();
+  std::lock_guard<std::mutex> lock(smart.mutex);
+  if (smart.infos.get(ptr) == nullptr) {
+    smart.infos.set(ptr, new SmartPointerInfo(info));
+  }
+}
+
+CLCXX_API const SmartPointerInfo *smart_pointer_info(cl_fixnum ptr) {
+  return smart_pointers().infos.get(ptr);
 }
 
-/* clos_load_defclass(
-      ecl_make_symbol("MAP","CL-USER"), // ecl_read_from_cstring("MAP"),
-      ECL_NIL,
-      ecl_list1(cl_list(4, ecl_read_from_cstring(":initform"),
-                        ecl_read_from_cstring("125"),
-                        ecl_read_from_cstring(":name"),
-                        ecl_read_from_cstring("x"))),
-                        ECL_NIL);*/
+} // namespace detail
 
+} // namespace clcxx
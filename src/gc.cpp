@@ -0,0 +1,569 @@
+#include "clcxx/gc.hpp"
+#include "clcxx/type_conversion.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+#include <ecl/gc/gc.h>
+
+namespace clcxx {
+
+namespace {
+/// A used slot holds its object and reference count, a free slot holds a
+/// null object and the index of the next free slot
+struct Slot {
+  cl_object object;
+  std::size_t count;
+};
+
+constexpr std::size_t no_slot = static_cast<std::size_t>(-1);
+constexpr std::size_t initial_capacity = 1024;
+
+struct HandleTable {
+  std::mutex mutex;
+  // uncollectable, hence scanned by the GC as one root region
+  Slot *slots = nullptr;
+  std::size_t capacity = 0;
+  std::size_t free_head = no_slot;
+};
+
+HandleTable &handle_table() {
+  // never destroyed, handles may be released during exit
+  static HandleTable *p_table = new HandleTable();
+  return *p_table;
+}
+
+void grow(HandleTable &table) {
+  const std::size_t capacity =
+      table.capacity == 0 ? initial_capacity : 2 * table.capacity;
+  Slot *slots =
+      static_cast<Slot *>(ecl_alloc_uncollectable(capacity * sizeof(Slot)));
+  if (table.capacity != 0) {
+    std::memcpy(slots, table.slots, table.capacity * sizeof(Slot));
+  }
+  for (std::size_t i = capacity; i-- > table.capacity;) {
+    slots[i].object = nullptr;
+    slots[i].count = table.free_head;
+    table.free_head = i;
+  }
+  // the old block stays a root until the objects are in the new one
+  Slot *old_slots = table.slots;
+  table.slots = slots;
+  table.capacity = capacity;
+  if (old_slots != nullptr) {
+    ecl_free_uncollectable(old_slots);
+  }
+}
+
+Slot &used_slot(HandleTable &table, gc_handle handle) {
+  if (handle >= table.capacity || table.slots[handle].object == nullptr) {
+    throw std::runtime_error("Invalid GC protection handle " +
+                             std::to_string(handle));
+  }
+  return table.slots[handle];
+}
+/// Queued destruction. Nodes are uncollectable so that objects living in GC
+/// memory stay alive until their destructor has run.
+struct PendingDestruction {
+  void *object;
+  void (*destroy)(void *);
+  PendingDestruction *next;
+};
+
+struct TypeStatsEntry {
+  std::string cpp_name;
+  gc_handle lisp_class;
+  detail::TypeStats stats;
+};
+
+struct TypeStatsTable {
+  std::mutex mutex;
+  std::vector<TypeStatsEntry *> entries;
+};
+
+/// Readable name of a type from its typeid name
+std::string demangled_name(const char *mangled) {
+#ifdef __GNUG__
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+  if (status == 0 && demangled != nullptr) {
+    const std::string result(demangled);
+    std::free(demangled);
+    return result;
+  }
+#endif
+  return mangled;
+}
+
+TypeStatsTable &type_stats_table_instance() {
+  // never destroyed, finalizers may update the counters during exit
+  static TypeStatsTable *p_table = new TypeStatsTable();
+  return *p_table;
+}
+
+/// Open disposal scopes of a thread: the boxes created in scope i are
+/// boxes[starts[i]] up to the start of the next scope
+struct DisposalScopes {
+  lisp_vector boxes;
+  std::vector<std::size_t> starts;
+};
+
+DisposalScopes &disposal_scopes() {
+  thread_local DisposalScopes p_scopes;
+  return p_scopes;
+}
+
+/// A collection is triggered once the allocations since the last one reach
+/// the heap size over this divisor, the default of the collector. The live
+/// external memory counts in the heap size.
+constexpr std::size_t free_space_divisor = 3;
+constexpr std::size_t min_external_trigger = std::size_t(8) << 20;
+
+std::atomic<std::size_t> g_external_total(0);
+/// Lowest external memory since the last collection: the growth is the live
+/// total minus this baseline, so removed memory delays the next collection
+std::atomic<std::size_t> g_external_at_gc(0);
+std::atomic<GC_word> g_external_gc_no(0);
+std::atomic<bool> g_external_collecting(false);
+
+/// Collections postponed on this thread by PacerPause
+struct PacerState {
+  unsigned depth = 0;
+  bool pending = false;
+};
+
+PacerState &pacer_state() {
+  thread_local PacerState p_state;
+  return p_state;
+}
+
+void collect_for_external_memory() {
+  if (!g_external_collecting.exchange(true)) {
+    GC_gcollect();
+    g_external_gc_no.store(GC_get_gc_no(), std::memory_order_relaxed);
+    g_external_at_gc.store(g_external_total.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+    g_external_collecting.store(false);
+  }
+}
+
+/// Marks the finalizers run by dispose as explicit deletions, restoring the
+/// previous state however the finalizer exits
+class ExplicitDeletionGuard {
+public:
+  ExplicitDeletionGuard() : m_previous(detail::explicit_deletion()) {
+    detail::explicit_deletion() = true;
+  }
+  ~ExplicitDeletionGuard() { detail::explicit_deletion() = m_previous; }
+  ExplicitDeletionGuard(const ExplicitDeletionGuard &) = delete;
+  ExplicitDeletionGuard &operator=(const ExplicitDeletionGuard &) = delete;
+
+private:
+  bool m_previous;
+};
+
+std::atomic<bool> g_deferred_finalization(false);
+std::atomic<PendingDestruction *> g_pending_head(nullptr);
+
+struct ReclamationThread {
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread thread;
+  bool stop = false;
+  // deferred finalization mode before the thread was started
+  bool previous_deferred = false;
+};
+
+ReclamationThread &reclamation_thread() {
+  static ReclamationThread *p_thread = new ReclamationThread();
+  return *p_thread;
+}
+
+// nobody is there to report to on the reclamation thread, and an escaping
+// exception would terminate the process
+void drain_quietly() {
+  try {
+    drain_finalization_queue();
+  } catch (...) {
+  }
+}
+
+void reclaim(std::chrono::milliseconds period) {
+  ecl_import_current_thread(ECL_NIL, ECL_NIL);
+  ReclamationThread &self = reclamation_thread();
+  std::unique_lock<std::mutex> lock(self.mutex);
+  while (!self.stop) {
+    self.wake.wait_for(lock, period);
+    lock.unlock();
+    drain_quietly();
+    lock.lock();
+  }
+  lock.unlock();
+  drain_quietly();
+  ecl_release_current_thread();
+}
+} // namespace
+
+CLCXX_API gc_handle gc_protect(cl_object obj) {
+  HandleTable &table = handle_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  if (table.free_head == no_slot) {
+    grow(table);
+  }
+  const gc_handle handle = table.free_head;
+  Slot &slot = table.slots[handle];
+  table.free_head = slot.count;
+  slot.object = obj;
+  slot.count = 1;
+  return handle;
+}
+
+CLCXX_API void gc_retain(gc_handle handle) {
+  HandleTable &table = handle_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  ++used_slot(table, handle).count;
+}
+
+CLCXX_API void gc_release(gc_handle handle) {
+  HandleTable &table = handle_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  Slot &slot = used_slot(table, handle);
+  if (--slot.count == 0) {
+    slot.object = nullptr;
+    slot.count = table.free_head;
+    table.free_head = handle;
+  }
+}
+
+CLCXX_API cl_object gc_get(gc_handle handle) {
+  HandleTable &table = handle_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return used_slot(table, handle).object;
+}
+
+namespace detail {
+CLCXX_API TypeStats &register_type_stats(const char *cpp_name,
+                                         cl_object lisp_class) {
+  TypeStatsEntry *entry = new TypeStatsEntry();
+  entry->cpp_name = demangled_name(cpp_name);
+  entry->lisp_class = gc_protect(lisp_class);
+  TypeStatsTable &table = type_stats_table_instance();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.entries.push_back(entry);
+  return entry->stats;
+}
+
+CLCXX_API bool &explicit_deletion() {
+  thread_local bool p_explicit = false;
+  return p_explicit;
+}
+
+CLCXX_API void track_for_disposal(cl_object box) {
+  DisposalScopes &scopes = disposal_scopes();
+  if (!scopes.starts.empty()) {
+    scopes.boxes.push_back(box);
+  }
+}
+} // namespace detail
+
+CLCXX_API cl_object type_stats_table() {
+  std::vector<TypeStatsEntry *> entries;
+  {
+    TypeStatsTable &table = type_stats_table_instance();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    entries = table.entries;
+  }
+  cl_object result = ECL_NIL;
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    const detail::TypeStats &stats = (*it)->stats;
+    const std::size_t created = stats.created.load(std::memory_order_relaxed);
+    const std::size_t finalized =
+        stats.finalized.load(std::memory_order_relaxed);
+    const std::size_t deleted = stats.deleted.load(std::memory_order_relaxed);
+    const std::size_t gc_reclaimed =
+        stats.gc_reclaimed.load(std::memory_order_relaxed);
+    const std::size_t released = finalized + deleted + gc_reclaimed;
+    const std::size_t live = created > released ? created - released : 0;
+    cl_object entry = cl_list(
+        16, ecl_make_keyword("TYPE"),
+        ecl_make_simple_base_string((*it)->cpp_name.c_str(), -1),
+        ecl_make_keyword("CLASS"), gc_get((*it)->lisp_class),
+        ecl_make_keyword("CREATED"), ecl_make_unsigned_integer(created),
+        ecl_make_keyword("FINALIZED"), ecl_make_unsigned_integer(finalized),
+        ecl_make_keyword("DELETED"), ecl_make_unsigned_integer(deleted),
+        ecl_make_keyword("GC-RECLAIMED"),
+        ecl_make_unsigned_integer(gc_reclaimed),
+        ecl_make_keyword("LIVE"), ecl_make_unsigned_integer(live),
+        ecl_make_keyword("BYTES"),
+        ecl_make_unsigned_integer(
+            stats.bytes.load(std::memory_order_relaxed)));
+    result = ecl_cons(entry, result);
+  }
+  return result;
+}
+
+CLCXX_API void add_external_memory(std::size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  const std::size_t total =
+      g_external_total.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  const GC_word gc_no = GC_get_gc_no();
+  if (g_external_gc_no.exchange(gc_no, std::memory_order_relaxed) != gc_no) {
+    // a collection ran since the last report
+    g_external_at_gc.store(total - bytes, std::memory_order_relaxed);
+  }
+  const std::size_t at_gc = g_external_at_gc.load(std::memory_order_relaxed);
+  const std::size_t growth = total > at_gc ? total - at_gc : 0;
+  const std::size_t trigger =
+      std::max((GC_get_heap_size() + total) / free_space_divisor,
+               min_external_trigger);
+  if (growth + GC_get_bytes_since_gc() < trigger) {
+    return;
+  }
+  PacerState &state = pacer_state();
+  if (state.depth > 0) {
+    state.pending = true;
+  } else {
+    collect_for_external_memory();
+  }
+}
+
+CLCXX_API void remove_external_memory(std::size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  const std::size_t total =
+      g_external_total.fetch_sub(bytes, std::memory_order_relaxed) - bytes;
+  // the growth is counted from the lowest total since the last collection
+  std::size_t at_gc = g_external_at_gc.load(std::memory_order_relaxed);
+  while (total < at_gc && !g_external_at_gc.compare_exchange_weak(
+                              at_gc, total, std::memory_order_relaxed)) {
+  }
+}
+
+CLCXX_API std::size_t external_memory() {
+  return g_external_total.load(std::memory_order_relaxed);
+}
+
+namespace detail {
+PacerPause::PacerPause() { ++pacer_state().depth; }
+
+PacerPause::~PacerPause() {
+  PacerState &state = pacer_state();
+  if (--state.depth == 0 && state.pending) {
+    state.pending = false;
+    collect_for_external_memory();
+  }
+}
+} // namespace detail
+
+CLCXX_API void dispose(cl_object handle) {
+  cl_object box = wrapped_box(handle);
+  cl_object fin = si_get_finalizer(box);
+  if (fin != ECL_NIL) {
+    si_set_finalizer(box, ECL_NIL);
+    ExplicitDeletionGuard guard;
+    cl_funcall(2, fin, box);
+  }
+  box->foreign.data = nullptr;
+}
+
+CLCXX_API void push_disposal_scope() {
+  DisposalScopes &scopes = disposal_scopes();
+  scopes.starts.push_back(scopes.boxes.size());
+}
+
+CLCXX_API std::size_t pop_disposal_scope() {
+  DisposalScopes &scopes = disposal_scopes();
+  if (scopes.starts.empty()) {
+    throw std::runtime_error("No disposal scope is open");
+  }
+  const std::size_t start = scopes.starts.back();
+  scopes.starts.pop_back();
+  std::size_t count = 0;
+  std::exception_ptr error;
+  while (scopes.boxes.size() > start) {
+    cl_object box = scopes.boxes.back();
+    scopes.boxes.pop_back();
+    if (box->foreign.data != nullptr) {
+      // a failing destructor must not leave the rest of the scope alive
+      try {
+        dispose(box);
+        ++count;
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return count;
+}
+
+CLCXX_API void set_deferred_finalization(bool enabled) {
+  g_deferred_finalization.store(enabled, std::memory_order_release);
+}
+
+CLCXX_API bool deferred_finalization() {
+  return g_deferred_finalization.load(std::memory_order_acquire);
+}
+
+CLCXX_API void defer_destruction(void *object, void (*destroy)(void *)) {
+  auto node = static_cast<PendingDestruction *>(
+      ecl_alloc_uncollectable(sizeof(PendingDestruction)));
+  node->object = object;
+  node->destroy = destroy;
+  node->next = g_pending_head.load(std::memory_order_relaxed);
+  while (!g_pending_head.compare_exchange_weak(node->next, node,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+  }
+}
+
+CLCXX_API std::size_t drain_finalization_queue() {
+  // taking the whole list at once leaves no room for ABA problems
+  PendingDestruction *node =
+      g_pending_head.exchange(nullptr, std::memory_order_acquire);
+  PendingDestruction *in_order = nullptr;
+  while (node != nullptr) {
+    PendingDestruction *next = node->next;
+    node->next = in_order;
+    in_order = node;
+    node = next;
+  }
+  std::size_t count = 0;
+  std::exception_ptr error;
+  while (in_order != nullptr) {
+    PendingDestruction *next = in_order->next;
+    try {
+      in_order->destroy(in_order->object);
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+    ecl_free_uncollectable(in_order);
+    in_order = next;
+    ++count;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return count;
+}
+
+CLCXX_API void start_reclamation_thread(std::chrono::milliseconds period) {
+  ReclamationThread &self = reclamation_thread();
+  std::lock_guard<std::mutex> lock(self.mutex);
+  if (self.thread.joinable()) {
+    throw std::runtime_error("The reclamation thread is already running");
+  }
+  self.stop = false;
+  self.previous_deferred = deferred_finalization();
+  set_deferred_finalization(true);
+  self.thread = std::thread(reclaim, period);
+}
+
+CLCXX_API void stop_reclamation_thread() {
+  ReclamationThread &self = reclamation_thread();
+  {
+    std::lock_guard<std::mutex> lock(self.mutex);
+    if (!self.thread.joinable()) {
+      return;
+    }
+    self.stop = true;
+  }
+  self.wake.notify_one();
+  self.thread.join();
+  bool previous_deferred = false;
+  {
+    std::lock_guard<std::mutex> lock(self.mutex);
+    previous_deferred = self.previous_deferred;
+  }
+  set_deferred_finalization(previous_deferred);
+  // objects queued after the last drain of the thread
+  drain_finalization_queue();
+}
+
+WeakLispRef::WeakLispRef(cl_object obj)
+    : m_ref(ECL_IMMEDIATE(obj) ? obj : si_make_weak_pointer(obj)),
+      m_immediate(ECL_IMMEDIATE(obj) != 0) {}
+
+cl_object WeakLispRef::get() const {
+  if (!m_ref) {
+    return ECL_NIL;
+  }
+  cl_object obj = m_ref.get();
+  return m_immediate ? obj : si_weak_pointer_value(obj);
+}
+
+bool WeakLispRef::expired() const {
+  if (!m_ref || m_immediate) {
+    return false;
+  }
+  // the second value is NIL once the link was cleared
+  si_weak_pointer_value(m_ref.get());
+  const cl_env_ptr env = ecl_process_env();
+  return env->nvalues > 1 && env->values[1] == ECL_NIL;
+}
+
+LispHashTable::LispHashTable(cl_object test, cl_object weakness)
+    : m_table(weakness == ECL_NIL
+                  ? cl_make_hash_table(2, ecl_make_keyword("TEST"), test)
+                  : cl_make_hash_table(4, ecl_make_keyword("TEST"), test,
+                                       ecl_make_keyword("WEAKNESS"),
+                                       weakness)) {}
+
+bool LispHashTable::find(cl_object key, cl_object &value) const {
+  cl_object found = ecl_gethash_safe(key, m_table.get(), OBJNULL);
+  if (found == OBJNULL) {
+    return false;
+  }
+  value = found;
+  return true;
+}
+
+cl_object LispHashTable::get(cl_object key, cl_object def) const {
+  return ecl_gethash_safe(key, m_table.get(), def);
+}
+
+void LispHashTable::set(cl_object key, cl_object value) {
+  ecl_sethash(key, m_table.get(), value);
+}
+
+bool LispHashTable::erase(cl_object key) {
+  return ecl_remhash(key, m_table.get());
+}
+
+void LispHashTable::clear() { cl_clrhash(m_table.get()); }
+
+std::size_t LispHashTable::size() const {
+  return static_cast<std::size_t>(
+      ecl_fixnum(cl_hash_table_count(m_table.get())));
+}
+
+WeakKeyHashMap::WeakKeyHashMap()
+    : LispHashTable(ecl_make_symbol("EQ", "CL"), ecl_make_keyword("KEY")) {}
+
+WeakValueHashMap::WeakValueHashMap()
+    : LispHashTable(ecl_make_symbol("EQL", "CL"), ecl_make_keyword("VALUE")) {}
+
+} // namespace clcxx
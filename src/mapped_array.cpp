@@ -0,0 +1,140 @@
+#include "clcxx/mapped_array.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace clcxx {
+
+namespace {
+
+/// Live mappings, indexed by the address handed to Lisp
+struct Mapping {
+  void *base;
+  std::size_t length;
+};
+
+std::mutex &mappings_mutex() {
+  static std::mutex p_mutex;
+  return p_mutex;
+}
+
+std::unordered_map<void *, Mapping> &mappings() {
+  static std::unordered_map<void *, Mapping> p_mappings;
+  return p_mappings;
+}
+
+/// Forget and unmap the mapping at data, returns false if there is none
+bool release_mapping(void *data) {
+  Mapping mapping = {nullptr, 0};
+  {
+    std::lock_guard<std::mutex> lock(mappings_mutex());
+    auto iter = mappings().find(data);
+    if (iter == mappings().end()) {
+      return false;
+    }
+    mapping = iter->second;
+    mappings().erase(iter);
+  }
+#ifndef _WIN32
+  munmap(mapping.base, mapping.length);
+#endif
+  return true;
+}
+
+cl_object unmap_array(cl_object arr) {
+  if (release_mapping(arr->array.self.b8)) {
+    arr->array.self.b8 = nullptr;
+    arr->array.dim = 0;
+  }
+  return ECL_NIL;
+}
+
+} // namespace
+
+namespace detail {
+
+CLCXX_API void *map_file(const std::string &path, std::size_t offset,
+                         std::size_t &length, MapAdvice advice) {
+#ifdef _WIN32
+  throw std::runtime_error("File backed arrays are not supported on Windows");
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || offset > static_cast<std::size_t>(st.st_size)) {
+    close(fd);
+    throw std::runtime_error("Offset " + std::to_string(offset) +
+                             " is past the end of " + path);
+  }
+  if (length == 0) {
+    length = st.st_size - offset;
+  }
+  if (length == 0 || offset + length > static_cast<std::size_t>(st.st_size)) {
+    close(fd);
+    throw std::runtime_error("Invalid range for mapping " + path);
+  }
+
+  // mmap wants a page aligned offset, map from the start of the page
+  const std::size_t page = sysconf(_SC_PAGESIZE);
+  const std::size_t skip = offset % page;
+  // private and writable: lisp vectors have no read-only flag, so a write
+  // must not fault, and must not reach the file
+  void *base = mmap(nullptr, length + skip, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, offset - skip);
+  close(fd);
+  if (base == MAP_FAILED) {
+    throw std::runtime_error("Could not map " + path);
+  }
+
+  int hint = MADV_NORMAL;
+  switch (advice) {
+  case MapAdvice::sequential:
+    hint = MADV_SEQUENTIAL;
+    break;
+  case MapAdvice::random:
+    hint = MADV_RANDOM;
+    break;
+  case MapAdvice::will_need:
+    hint = MADV_WILLNEED;
+    break;
+  default:
+    break;
+  }
+  if (hint != MADV_NORMAL) {
+    madvise(base, length + skip, hint);
+  }
+
+  void *data = static_cast<char *>(base) + skip;
+  std::lock_guard<std::mutex> lock(mappings_mutex());
+  mappings()[data] = Mapping{base, length + skip};
+  return data;
+#endif
+}
+
+CLCXX_API void unmap_file(void *data) { release_mapping(data); }
+
+CLCXX_API cl_object mapped_array_finalizer() {
+  static cl_object p_finalizer = nullptr;
+  static const bool p_rooted = [] {
+    p_finalizer = ecl_make_cfun((cl_objectfn_fixed)(void (*)(void))unmap_array,
+                                ECL_NIL, ECL_NIL, 1);
+    ecl_register_root(&p_finalizer);
+    return true;
+  }();
+  (void)p_rooted;
+  return p_finalizer;
+}
+
+} // namespace detail
+
+} // namespace clcxx
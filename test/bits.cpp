@@ -0,0 +1,72 @@
+#include "test_common.hpp"
+
+#include "clcxx/array.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Bits set at the multiples of 3 and at the last index
+std::vector<bool> pattern(std::size_t n) {
+  std::vector<bool> bits(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    bits[i] = i % 3 == 0 || i + 1 == n;
+  }
+  return bits;
+}
+
+void vector_round_trip() {
+  // sizes around the 64 bit words and the bytes of the packing
+  for (std::size_t n : {0, 1, 7, 8, 9, 63, 64, 65, 130}) {
+    // converted by value, as a function result
+    cl_object v = clcxx::convert_to_lisp(pattern(n));
+    CLCXX_CHECK(ecl_t_of(v) == t_bitvector);
+    CLCXX_CHECK(v->vector.fillp == n);
+    CLCXX_CHECK(clcxx::convert_to_cpp<std::vector<bool>>(v) == pattern(n));
+  }
+}
+
+void lisp_bit_order() {
+  // lisp keeps bit 0 in the most significant bit of the first byte
+  std::vector<bool> bits(10);
+  bits[0] = true;
+  bits[9] = true;
+  cl_object v = clcxx::convert_to_lisp(std::move(bits));
+  CLCXX_CHECK(v->vector.self.bit[0] == 0x80);
+  CLCXX_CHECK(v->vector.self.bit[1] == 0x40);
+}
+
+void displaced_bits() {
+  // a bit-vector displaced 3 bits into 0b10110011 0b01000000
+  byte storage[3] = {0xB3, 0x40, 0};
+  cl_object v = ecl_alloc_simple_vector(0, ecl_aet_bit);
+  v->vector.self.bit = storage;
+  v->vector.offset = 3;
+  v->vector.fillp = v->vector.dim = 9;
+  const std::vector<bool> bits = clcxx::convert_to_cpp<std::vector<bool>>(v);
+  const bool expected[9] = {1, 0, 0, 1, 1, 0, 1, 0, 0};
+  CLCXX_CHECK(std::equal(bits.begin(), bits.end(), expected));
+}
+
+void bitset_round_trip() {
+  std::bitset<70> bits;
+  bits.set(0).set(5).set(64).set(69);
+  cl_object v = clcxx::convert_to_lisp(std::bitset<70>(bits));
+  CLCXX_CHECK(v->vector.fillp == 70);
+  CLCXX_CHECK(clcxx::convert_to_cpp<std::bitset<70>>(v) == bits);
+  CLCXX_CHECK_THROWS(clcxx::convert_to_cpp<std::bitset<64>>(v),
+                     std::runtime_error);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  vector_round_trip();
+  lisp_bit_order();
+  displaced_bits();
+  bitset_round_trip();
+  return EXIT_SUCCESS;
+}
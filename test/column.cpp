@@ -0,0 +1,55 @@
+#include "test_common.hpp"
+
+#include "clcxx/array.hpp"
+
+namespace {
+struct Record {
+  int id;
+  double value;
+  char tag;
+};
+
+std::vector<Record> records() {
+  return {{1, 0.5, 'a'}, {2, 1.5, 'b'}, {3, 2.5, 'c'}};
+}
+
+void strided_access() {
+  std::vector<Record> rows = records();
+  clcxx::Column<double> values = clcxx::column(rows, &Record::value);
+  CLCXX_CHECK(values.size() == 3);
+  CLCXX_CHECK(values.stride() == sizeof(Record));
+  CLCXX_CHECK(&values[2] == &rows[2].value);
+  // the column refers to the records
+  values[1] = 4.0;
+  CLCXX_CHECK(rows[1].value == 4.0);
+}
+
+void const_records() {
+  const std::vector<Record> rows = records();
+  clcxx::Column<const int> ids = clcxx::column(rows, &Record::id);
+  CLCXX_CHECK(ids.stride() == sizeof(Record));
+  CLCXX_CHECK(ids[0] == 1 && ids[2] == 3);
+}
+
+void copied_to_lisp() {
+  std::vector<Record> rows = records();
+  cl_object ids = clcxx::convert_to_lisp(clcxx::column(rows, &Record::id));
+  const int *data = clcxx::detail::array_data<int>(ids);
+  // one element per record, without the neighbouring fields
+  CLCXX_CHECK(data[0] == 1 && data[1] == 2 && data[2] == 3);
+  rows[0].id = 10;
+  CLCXX_CHECK(data[0] == 1);
+  const std::vector<Record> &const_rows = rows;
+  cl_object values =
+      clcxx::convert_to_lisp(clcxx::column(const_rows, &Record::value));
+  CLCXX_CHECK(clcxx::detail::array_data<double>(values)[2] == 2.5);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  strided_access();
+  const_records();
+  copied_to_lisp();
+  return EXIT_SUCCESS;
+}
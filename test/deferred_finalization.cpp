@@ -0,0 +1,102 @@
+#include "test_common.hpp"
+
+#include <thread>
+
+using clcxx_test::Counted;
+
+namespace {
+struct Plain : Counted<Plain> {};
+
+/// Throws from its destructor when fail is set
+struct Failing : Counted<Failing> {
+  bool fail = false;
+  ~Failing() noexcept(false) {
+    if (fail) {
+      throw std::runtime_error("destructor failed");
+    }
+  }
+};
+
+cl_object failing() {
+  cl_object handle = clcxx::create<Failing>();
+  clcxx::unbox_wrapped_ptr<Failing>(handle)->fail = true;
+  return handle;
+}
+
+/// Run the finalizer of a handle as the collector would
+void finalize(cl_object handle) {
+  cl_object box = clcxx::wrapped_box(handle);
+  cl_funcall(2, si_get_finalizer(box), box);
+}
+
+void drain() {
+  clcxx::set_deferred_finalization(true);
+  cl_object first = clcxx::create<Plain>();
+  cl_object second = clcxx::create<Plain>();
+  finalize(first);
+  finalize(second);
+  // queued, not destroyed, but the handles are already empty
+  CLCXX_CHECK(Plain::live == 2);
+  CLCXX_CHECK(clcxx::wrapped_box(first)->foreign.data == nullptr);
+  CLCXX_CHECK(clcxx::drain_finalization_queue() == 2);
+  CLCXX_CHECK(Plain::live == 0);
+  CLCXX_CHECK(clcxx::drain_finalization_queue() == 0);
+  clcxx::set_deferred_finalization(false);
+}
+
+void dispose_is_not_deferred() {
+  clcxx::set_deferred_finalization(true);
+  clcxx::dispose(clcxx::create<Plain>());
+  CLCXX_CHECK(Plain::live == 0);
+  CLCXX_CHECK(clcxx::drain_finalization_queue() == 0);
+  clcxx::set_deferred_finalization(false);
+}
+
+void drain_past_failures() {
+  clcxx::set_deferred_finalization(true);
+  finalize(failing());
+  finalize(clcxx::create<Plain>());
+  finalize(failing());
+  // every node is released and the first error reaches the caller
+  CLCXX_CHECK_THROWS(clcxx::drain_finalization_queue(), std::runtime_error);
+  CLCXX_CHECK(Failing::live == 0);
+  CLCXX_CHECK(Plain::live == 0);
+  CLCXX_CHECK(clcxx::drain_finalization_queue() == 0);
+  clcxx::set_deferred_finalization(false);
+}
+
+void reclamation_thread() {
+  clcxx::start_reclamation_thread(std::chrono::hours(1));
+  CLCXX_CHECK(clcxx::deferred_finalization());
+  finalize(clcxx::create<Plain>());
+  CLCXX_CHECK(Plain::live == 1);
+  // stopping restores the previous mode and drains what was queued
+  clcxx::stop_reclamation_thread();
+  CLCXX_CHECK(!clcxx::deferred_finalization());
+  CLCXX_CHECK(Plain::live == 0);
+}
+
+void reclamation_thread_survives_failures() {
+  clcxx::start_reclamation_thread(std::chrono::milliseconds(1));
+  finalize(failing());
+  finalize(clcxx::create<Plain>());
+  // the thread drops the error and keeps draining
+  while (Plain::live != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CLCXX_CHECK(Failing::live == 0);
+  clcxx::stop_reclamation_thread();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Plain>("PLAIN");
+  clcxx_test::define_class<Failing>("FAILING");
+  drain();
+  dispose_is_not_deferred();
+  drain_past_failures();
+  reclamation_thread();
+  reclamation_thread_survives_failures();
+  return EXIT_SUCCESS;
+}
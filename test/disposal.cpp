@@ -0,0 +1,82 @@
+#include "test_common.hpp"
+
+using clcxx_test::Counted;
+
+namespace {
+struct Plain : Counted<Plain> {};
+
+/// Throws from its destructor when fail is set
+struct Failing : Counted<Failing> {
+  bool fail = false;
+  ~Failing() noexcept(false) {
+    if (fail) {
+      throw std::runtime_error("destructor failed");
+    }
+  }
+};
+
+void dispose_handle() {
+  cl_object handle = clcxx::create<Plain>();
+  CLCXX_CHECK(Plain::live == 1);
+  clcxx::dispose(handle);
+  CLCXX_CHECK(Plain::live == 0);
+  CLCXX_CHECK(clcxx::wrapped_box(handle)->foreign.data == nullptr);
+  CLCXX_CHECK(!clcxx::detail::explicit_deletion());
+  // disposing twice is a no-op
+  clcxx::dispose(handle);
+  CLCXX_CHECK(Plain::live == 0);
+}
+
+void dispose_failing_handle() {
+  cl_object handle = clcxx::create<Failing>();
+  clcxx::unbox_wrapped_ptr<Failing>(handle)->fail = true;
+  CLCXX_CHECK_THROWS(clcxx::dispose(handle), std::runtime_error);
+  // the explicit deletion flag does not leak into later finalizers
+  CLCXX_CHECK(!clcxx::detail::explicit_deletion());
+  CLCXX_CHECK(clcxx::wrapped_box(handle)->foreign.data == nullptr);
+}
+
+void nested_scopes() {
+  clcxx::push_disposal_scope();
+  clcxx::create<Plain>();
+  clcxx::push_disposal_scope();
+  clcxx::create<Plain>();
+  clcxx::create<Plain>();
+  CLCXX_CHECK(clcxx::pop_disposal_scope() == 2);
+  CLCXX_CHECK(Plain::live == 1);
+  CLCXX_CHECK(clcxx::pop_disposal_scope() == 1);
+  CLCXX_CHECK(Plain::live == 0);
+  CLCXX_CHECK_THROWS(clcxx::pop_disposal_scope(), std::runtime_error);
+}
+
+void scope_with_failing_destructor() {
+  {
+    clcxx::DisposalScope scope;
+    clcxx::create<Plain>();
+    cl_object failing = clcxx::create<Failing>();
+    clcxx::create<Plain>();
+    clcxx::unbox_wrapped_ptr<Failing>(failing)->fail = true;
+    // the error is reported, and the other objects are still disposed
+    CLCXX_CHECK_THROWS(scope.close(), std::runtime_error);
+    CLCXX_CHECK(Plain::live == 0);
+  }
+  {
+    // the destructor of the scope swallows the error
+    clcxx::DisposalScope scope;
+    cl_object failing = clcxx::create<Failing>();
+    clcxx::unbox_wrapped_ptr<Failing>(failing)->fail = true;
+  }
+  CLCXX_CHECK(!clcxx::detail::explicit_deletion());
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Plain>("PLAIN");
+  clcxx_test::define_class<Failing>("FAILING");
+  dispose_handle();
+  dispose_failing_handle();
+  nested_scopes();
+  scope_with_failing_destructor();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include "test_common.hpp"
+
+namespace {
+struct Inner {
+  int value = 7;
+};
+
+struct Record {
+  int first = 1;
+  Inner inner;
+  int last = 3;
+};
+
+/// Simple vector of the encoded member pointers, as passed by fields()
+template <typename... Ms> cl_object members(Ms Record::*... ms) {
+  cl_object data = ecl_alloc_simple_vector(sizeof...(Ms), ecl_aet_object);
+  cl_index i = 0;
+  auto dummy = {(data->vector.self.t[i++] =
+                     clcxx::detail::FieldAccess<Record, Ms>::encode(ms))...};
+  (void)dummy;
+  return data;
+}
+
+void multiple_values() {
+  Record record;
+  cl_object handle = clcxx::convert_to_lisp(&record);
+  cl_object data = members(&Record::first, &Record::inner, &Record::last);
+  cl_object result =
+      clcxx::detail::FieldsAccess<Record, int, Inner, int>::get(data, handle);
+  const cl_env_ptr env = ecl_process_env();
+  CLCXX_CHECK(env->nvalues == 3);
+  // boxing the wrapped field must not overwrite the first value
+  CLCXX_CHECK(result == ecl_make_fixnum(1));
+  CLCXX_CHECK(env->values[0] == ecl_make_fixnum(1));
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Inner>(env->values[1]) == &record.inner);
+  CLCXX_CHECK(env->values[2] == ecl_make_fixnum(3));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Inner>("INNER");
+  clcxx_test::define_class<Record>("RECORD");
+  multiple_values();
+  return EXIT_SUCCESS;
+}
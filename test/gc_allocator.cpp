@@ -0,0 +1,50 @@
+#include "test_common.hpp"
+
+#include <ecl/gc/gc.h>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <new>
+#include <utility>
+
+namespace {
+void lisp_vector_storage() {
+  clcxx::lisp_vector objects;
+  for (cl_fixnum i = 0; i != 1000; ++i) {
+    objects.push_back(ecl_make_simple_base_string("element", -1));
+  }
+  // the grown storage is still in GC memory, hence scanned
+  CLCXX_CHECK(GC_base(objects.data()) != nullptr);
+  CLCXX_CHECK(GC_base(&objects.back()) != nullptr);
+  clcxx::lisp_vector copy = objects;
+  CLCXX_CHECK(copy == objects);
+  CLCXX_CHECK(GC_base(copy.data()) != GC_base(objects.data()));
+}
+
+void rebound_containers() {
+  // node based containers rebind the allocator to their node type
+  std::list<cl_object, clcxx::gc_allocator<cl_object>> list;
+  list.push_back(ecl_make_fixnum(1));
+  CLCXX_CHECK(GC_base(&list.front()) != nullptr);
+  typedef std::pair<const int, cl_object> Entry;
+  std::map<int, cl_object, std::less<int>, clcxx::gc_allocator<Entry>> map;
+  map[3] = ECL_T;
+  CLCXX_CHECK(GC_base(&map[3]) != nullptr);
+  CLCXX_CHECK(clcxx::gc_allocator<int>() == clcxx::gc_allocator<Entry>());
+}
+
+void oversized_allocation() {
+  clcxx::gc_allocator<cl_object> allocator;
+  CLCXX_CHECK_THROWS(allocator.allocate(static_cast<std::size_t>(-1)),
+                     std::bad_alloc);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  lisp_vector_storage();
+  rebound_containers();
+  oversized_allocation();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include "test_common.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace {
+void reference_counts() {
+  cl_object obj = ecl_make_fixnum(42);
+  const clcxx::gc_handle handle = clcxx::gc_protect(obj);
+  CLCXX_CHECK(clcxx::gc_get(handle) == obj);
+  clcxx::gc_retain(handle);
+  clcxx::gc_release(handle);
+  // one reference left
+  CLCXX_CHECK(clcxx::gc_get(handle) == obj);
+  clcxx::gc_release(handle);
+  CLCXX_CHECK_THROWS(clcxx::gc_get(handle), std::runtime_error);
+  CLCXX_CHECK_THROWS(clcxx::gc_release(handle), std::runtime_error);
+}
+
+void free_list_reuse() {
+  const clcxx::gc_handle first = clcxx::gc_protect(ecl_make_fixnum(1));
+  const clcxx::gc_handle second = clcxx::gc_protect(ecl_make_fixnum(2));
+  CLCXX_CHECK(first != second);
+  clcxx::gc_release(first);
+  clcxx::gc_release(second);
+  // the last freed slot is reused first
+  const clcxx::gc_handle reused = clcxx::gc_protect(ecl_make_fixnum(3));
+  CLCXX_CHECK(reused == second);
+  CLCXX_CHECK(clcxx::gc_protect(ecl_make_fixnum(4)) == first);
+  clcxx::gc_release(reused);
+  clcxx::gc_release(first);
+}
+
+void growth() {
+  // well past the initial capacity, objects move to the grown table
+  std::vector<clcxx::gc_handle> handles;
+  for (cl_fixnum i = 0; i != 5000; ++i) {
+    handles.push_back(clcxx::gc_protect(ecl_make_fixnum(i)));
+  }
+  for (cl_fixnum i = 0; i != 5000; ++i) {
+    CLCXX_CHECK(clcxx::gc_get(handles[i]) == ecl_make_fixnum(i));
+  }
+  for (clcxx::gc_handle handle : handles) {
+    clcxx::gc_release(handle);
+  }
+}
+
+void protected_refs() {
+  cl_object obj = ecl_make_fixnum(7);
+  clcxx::ProtectedLispRef ref(obj);
+  {
+    clcxx::ProtectedLispRef copy = ref;
+    clcxx::ProtectedLispRef moved = std::move(copy);
+    CLCXX_CHECK(!copy && moved.get() == obj);
+  }
+  // the copy released its own reference only
+  CLCXX_CHECK(ref.get() == obj);
+  ref = clcxx::ProtectedLispRef();
+  CLCXX_CHECK(!ref && ref.get() == ECL_NIL);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  reference_counts();
+  free_list_reuse();
+  growth();
+  protected_refs();
+  return EXIT_SUCCESS;
+}
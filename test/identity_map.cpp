@@ -0,0 +1,56 @@
+#include "test_common.hpp"
+
+using clcxx_test::Counted;
+
+namespace {
+struct Node : Counted<Node> {
+  int value = 0;
+};
+} // namespace
+
+namespace clcxx {
+template <> struct identity_mapped<Node> : std::true_type {};
+} // namespace clcxx
+
+namespace {
+void same_handle() {
+  Node node;
+  cl_object first = clcxx::convert_to_lisp(&node);
+  cl_object second = clcxx::convert_to_lisp(&node);
+  CLCXX_CHECK(first == second);
+  CLCXX_CHECK(clcxx::convert_to_lisp(static_cast<Node &>(node)) == first);
+  // borrowed handles are not owned
+  CLCXX_CHECK(si_get_finalizer(clcxx::wrapped_box(first)) == ECL_NIL);
+  clcxx::dispose(first);
+}
+
+void owned_handle() {
+  cl_object owned = clcxx::create<Node>();
+  Node *node = clcxx::unbox_wrapped_ptr<Node>(owned);
+  // a borrowed reference to an owned object gives the owning handle
+  CLCXX_CHECK(clcxx::convert_to_lisp(node) == owned);
+  CLCXX_CHECK(si_get_finalizer(clcxx::wrapped_box(owned)) != ECL_NIL);
+  clcxx::dispose(owned);
+  CLCXX_CHECK(Node::live == 0);
+}
+
+void deleted_object() {
+  Node *node = new Node();
+  cl_object stale = clcxx::convert_to_lisp(node);
+  clcxx::dispose(stale);
+  // the emptied handle is not reused for an object at the same address
+  cl_object fresh = clcxx::convert_to_lisp(node);
+  CLCXX_CHECK(fresh != stale);
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Node>(fresh) == node);
+  delete node;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Node>("NODE");
+  same_handle();
+  owned_handle();
+  deleted_object();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "test_common.hpp"
+
+using clcxx_test::Counted;
+
+namespace {
+/// Counts the objects released with delete
+struct Owned : Counted<Owned> {
+  static int deleted;
+  static void operator delete(void *p) {
+    ++deleted;
+    ::operator delete(p);
+  }
+};
+
+int Owned::deleted = 0;
+
+struct Pooled : Counted<Pooled> {
+  int value = 0;
+};
+} // namespace
+
+namespace clcxx {
+template <> struct allocation_policy<Pooled> {
+  typedef SlabAllocation<4> type;
+};
+} // namespace clcxx
+
+namespace {
+
+void pointer_from_new() {
+  // GcAllocation is the default policy, but the pointer was not allocated
+  // by it and must be released with delete
+  cl_object handle = clcxx::boxed_cpp_pointer(
+      new Owned(), clcxx::static_type_mapping<Owned>::lisp_type(), true);
+  clcxx::dispose(handle);
+  CLCXX_CHECK(Owned::live == 0);
+  CLCXX_CHECK(Owned::deleted == 1);
+}
+
+void policy_allocation() {
+  // objects created by the policy are released by it, in GC memory
+  clcxx::dispose(clcxx::create<Owned>());
+  CLCXX_CHECK(Owned::live == 0);
+  CLCXX_CHECK(Owned::deleted == 1);
+}
+
+void unique_ptr_from_new() {
+  Owned *raw = new Owned();
+  cl_object handle = clcxx::boxed_cpp_pointer(
+      raw, clcxx::static_type_mapping<Owned>::lisp_type(), true);
+  std::unique_ptr<Owned> back =
+      clcxx::convert_to_cpp<std::unique_ptr<Owned>>(handle);
+  CLCXX_CHECK(back.get() == raw);
+  back.reset();
+  CLCXX_CHECK(Owned::deleted == 2);
+}
+
+void slab_pointer_from_new() {
+  cl_object dt = clcxx::static_type_mapping<Pooled>::lisp_type();
+  Pooled *raw = new Pooled();
+  clcxx::dispose(clcxx::boxed_cpp_pointer(raw, dt, true));
+  CLCXX_CHECK(Pooled::live == 0);
+  // the pointer went back to operator new, not to the slab free list
+  cl_object handle = clcxx::create<Pooled>();
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Pooled>(handle) != raw);
+  clcxx::dispose(handle);
+}
+
+void slab_recycling() {
+  cl_object first = clcxx::create<Pooled>();
+  Pooled *storage = clcxx::unbox_wrapped_ptr<Pooled>(first);
+  clcxx::dispose(first);
+  // objects the slab allocated are recycled through its free list
+  cl_object second = clcxx::create<Pooled>();
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Pooled>(second) == storage);
+  clcxx::dispose(second);
+  CLCXX_CHECK(Pooled::live == 0);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Owned>("OWNED");
+  clcxx_test::define_class<Pooled>("POOLED");
+  pointer_from_new();
+  policy_allocation();
+  unique_ptr_from_new();
+  slab_pointer_from_new();
+  slab_recycling();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#include "test_common.hpp"
+
+#include <atomic>
+#include <thread>
+#include <typeindex>
+
+namespace {
+struct Retried {};
+struct Shared {};
+
+void retry_after_failure() {
+  cl_object name = ecl_read_from_cstring("RETRIED");
+  int calls = 0;
+  clcxx::detail::add_pending_class(
+      std::type_index(typeid(Retried)), name, [&calls]() {
+        if (++calls == 1) {
+          throw std::runtime_error("instantiation failed");
+        }
+      });
+  CLCXX_CHECK_THROWS(clcxx::detail::instantiate_pending(name),
+                     std::runtime_error);
+  // the failed instantiation is still pending, by name and by type
+  CLCXX_CHECK(clcxx::detail::instantiate_pending(
+      std::type_index(typeid(Retried))));
+  CLCXX_CHECK(calls == 2);
+  CLCXX_CHECK(!clcxx::detail::instantiate_pending(name));
+}
+
+void single_instantiation() {
+  cl_object name = ecl_read_from_cstring("SHARED");
+  std::atomic<bool> started(false);
+  std::atomic<int> calls(0);
+  clcxx::detail::add_pending_class(
+      std::type_index(typeid(Shared)), name, [&started, &calls]() {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++calls;
+      });
+  std::thread first([name]() { clcxx::detail::instantiate_pending(name); });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  // a lookup during the instantiation waits for it instead of failing
+  CLCXX_CHECK(clcxx::detail::instantiate_pending(name));
+  CLCXX_CHECK(calls == 1);
+  first.join();
+  CLCXX_CHECK(calls == 1);
+  CLCXX_CHECK(!clcxx::detail::instantiate_pending(name));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  retry_after_failure();
+  single_instantiation();
+  return EXIT_SUCCESS;
+}
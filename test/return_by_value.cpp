@@ -0,0 +1,58 @@
+#include "test_common.hpp"
+
+#include <array>
+#include <functional>
+
+namespace {
+/// Large object counting its copies and moves
+template <typename Tag> struct Matrix {
+  static int copies;
+  static int moves;
+  std::array<double, 256> data;
+
+  explicit Matrix(double fill) { data.fill(fill); }
+  Matrix(const Matrix &other) : data(other.data) { ++copies; }
+  Matrix(Matrix &&other) : data(other.data) { ++moves; }
+};
+
+template <typename Tag> int Matrix<Tag>::copies = 0;
+template <typename Tag> int Matrix<Tag>::moves = 0;
+
+struct GcTag {};
+struct HeapTag {};
+struct SlabTag {};
+} // namespace
+
+namespace clcxx {
+template <> struct allocation_policy<Matrix<HeapTag>> {
+  typedef HeapAllocation type;
+};
+template <> struct allocation_policy<Matrix<SlabTag>> {
+  typedef SlabAllocation<4> type;
+};
+} // namespace clcxx
+
+namespace {
+/// Call f the way a function defined with defun is called from lisp
+template <typename Tag> void returns_in_place(const char *name) {
+  typedef Matrix<Tag> MatrixT;
+  clcxx_test::define_class<MatrixT>(name);
+  std::function<MatrixT(int)> f = [](int fill) { return MatrixT(fill); };
+  cl_object handle = clcxx::detail::ReturnTypeAdapter<MatrixT, int>()(
+      &f, ecl_make_fixnum(3));
+  MatrixT *matrix = clcxx::unbox_wrapped_ptr<MatrixT>(handle);
+  CLCXX_CHECK(matrix->data[255] == 3.0);
+  // the returned prvalue initializes the handle storage
+  CLCXX_CHECK(MatrixT::copies == 0);
+  CLCXX_CHECK(MatrixT::moves == 0);
+  clcxx::dispose(handle);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  returns_in_place<GcTag>("GC-MATRIX");
+  returns_in_place<HeapTag>("HEAP-MATRIX");
+  returns_in_place<SlabTag>("SLAB-MATRIX");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "clcxx/clcxx.hpp"
+
+/// Abort the test with the failed condition and its location
+#define CLCXX_CHECK(cond)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      std::exit(EXIT_FAILURE);                                                 \
+    }                                                                          \
+  } while (0)
+
+/// Check that expr throws an exception of type E
+#define CLCXX_CHECK_THROWS(expr, E)                                            \
+  do {                                                                         \
+    bool p_thrown = false;                                                     \
+    try {                                                                      \
+      expr;                                                                    \
+    } catch (const E &) {                                                      \
+      p_thrown = true;                                                         \
+    }                                                                          \
+    CLCXX_CHECK(p_thrown && #expr);                                            \
+  } while (0)
+
+namespace clcxx_test {
+
+/// ECL booted for the lifetime of a test
+class LispRuntime {
+public:
+  LispRuntime(int argc, char **argv) { cl_boot(argc, argv); }
+  ~LispRuntime() { cl_shutdown(); }
+  LispRuntime(const LispRuntime &) = delete;
+  LispRuntime &operator=(const LispRuntime &) = delete;
+};
+
+/// Define the lisp class of a wrapped type, without a package
+template <typename T> cl_object define_class(const char *name) {
+  cl_object dt = clcxx::new_datatype(ecl_read_from_cstring(name), ECL_NIL);
+  clcxx::static_type_mapping<T>::set_lisp_type(dt);
+  return dt;
+}
+
+/// Objects counting their live instances
+template <typename Tag> struct Counted {
+  static int live;
+  Counted() { ++live; }
+  Counted(const Counted &) { ++live; }
+  ~Counted() { --live; }
+};
+
+template <typename Tag> int Counted<Tag>::live = 0;
+
+} // namespace clcxx_test
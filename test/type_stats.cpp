@@ -0,0 +1,69 @@
+#include "test_common.hpp"
+
+using clcxx_test::Counted;
+
+namespace {
+/// Owns a buffer outside of the object, reported through object_size
+struct Buffer : Counted<Buffer> {
+  std::size_t capacity = 4096;
+};
+
+/// Trivially destructible, reclaimed by the GC without a finalizer
+struct Point {
+  int x;
+  int y;
+};
+} // namespace
+
+namespace clcxx {
+template <> struct object_size<Buffer> {
+  static std::size_t bytes(const Buffer &buffer) {
+    return sizeof(Buffer) + buffer.capacity;
+  }
+};
+} // namespace clcxx
+
+namespace {
+/// Run the finalizer of a handle as the collector would
+void finalize(cl_object handle) {
+  cl_object box = clcxx::wrapped_box(handle);
+  cl_funcall(2, si_get_finalizer(box), box);
+}
+
+void finalized_and_deleted() {
+  const clcxx::detail::TypeStats &stats =
+      clcxx::detail::type_stats<Buffer>(ECL_NIL);
+  const std::size_t external = clcxx::external_memory();
+  cl_object collected = clcxx::create<Buffer>();
+  cl_object disposed = clcxx::create<Buffer>();
+  CLCXX_CHECK(stats.created == 2);
+  CLCXX_CHECK(stats.bytes == 2 * (sizeof(Buffer) + 4096));
+  // the object itself lies in GC memory, only its buffer is external
+  CLCXX_CHECK(clcxx::external_memory() == external + 2 * 4096);
+  finalize(collected);
+  CLCXX_CHECK(stats.finalized == 1 && stats.deleted == 0);
+  clcxx::dispose(disposed);
+  CLCXX_CHECK(stats.finalized == 1 && stats.deleted == 1);
+  CLCXX_CHECK(stats.bytes == 0);
+  CLCXX_CHECK(clcxx::external_memory() == external);
+  CLCXX_CHECK(Buffer::live == 0);
+}
+
+void reclaimed_unobserved() {
+  const clcxx::detail::TypeStats &stats =
+      clcxx::detail::type_stats<Point>(ECL_NIL);
+  clcxx::create<Point>();
+  // counted as reclaimed at once, never live
+  CLCXX_CHECK(stats.created == 1 && stats.gc_reclaimed == 1);
+  CLCXX_CHECK(stats.bytes == 0);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Buffer>("BUFFER");
+  clcxx_test::define_class<Point>("POINT");
+  finalized_and_deleted();
+  reclaimed_unobserved();
+  return EXIT_SUCCESS;
+}
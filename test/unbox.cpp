@@ -0,0 +1,63 @@
+#include "test_common.hpp"
+
+#include "clcxx/array.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace {
+/// General lisp vector holding the given elements
+cl_object general_vector(std::initializer_list<cl_object> elements) {
+  cl_object v = ecl_alloc_simple_vector(elements.size(), ecl_aet_object);
+  std::copy(elements.begin(), elements.end(), v->vector.self.t);
+  return v;
+}
+
+void fixnums() {
+  cl_object v = general_vector(
+      {ecl_make_fixnum(1), ecl_make_fixnum(-2), ecl_make_fixnum(3)});
+  std::vector<int16_t> out = clcxx::unbox_vector<int16_t>(v);
+  CLCXX_CHECK(out[0] == 1 && out[1] == -2 && out[2] == 3);
+}
+
+void single_floats() {
+  cl_object v =
+      general_vector({ecl_make_single_float(0.5f), ecl_make_single_float(1.5f)});
+  std::vector<float> out = clcxx::unbox_vector<float>(v);
+  CLCXX_CHECK(out[0] == 0.5f && out[1] == 1.5f);
+}
+
+void mixed() {
+  // the fast loop stops at the first double, the rest goes one by one
+  cl_object v = general_vector({ecl_make_fixnum(1), ecl_make_fixnum(2),
+                                ecl_make_double_float(2.5),
+                                ecl_make_single_float(0.25f)});
+  std::vector<double> out = clcxx::unbox_vector<double>(v);
+  CLCXX_CHECK(out[0] == 1.0 && out[1] == 2.0);
+  CLCXX_CHECK(out[2] == 2.5 && out[3] == 0.25);
+}
+
+void unwrapped_element_type() {
+  // int8_t has no lisp wrapper, the error names its lisp type nonetheless
+  cl_object v = general_vector({ecl_make_fixnum(1), ecl_make_fixnum(300)});
+  std::string message;
+  try {
+    clcxx::unbox_vector<int8_t>(v);
+  } catch (const std::runtime_error &err) {
+    message = err.what();
+  }
+  CLCXX_CHECK(message.find("Element 1") != std::string::npos);
+  CLCXX_CHECK(message.find("(SIGNED-BYTE 8)") != std::string::npos);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  fixnums();
+  single_floats();
+  mixed();
+  unwrapped_element_type();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include <memory>
+
+#include "test_common.hpp"
+
+using clcxx_test::Counted;
+
+namespace {
+struct Resource : Counted<Resource> {
+  int value = 3;
+};
+
+int g_deleted = 0;
+
+/// Stateless, the handle then holds the resource itself
+struct CountingDelete {
+  void operator()(Resource *r) const {
+    ++g_deleted;
+    delete r;
+  }
+};
+
+/// Stateful, the handle then holds the unique_ptr
+struct TaggedDelete {
+  int tag = 0;
+  void operator()(Resource *r) const {
+    ++g_deleted;
+    delete r;
+  }
+};
+
+void round_trip() {
+  Resource *raw = new Resource();
+  cl_object handle = clcxx::convert_to_lisp(std::unique_ptr<Resource>(raw));
+  CLCXX_CHECK(clcxx::convert_to_cpp<Resource &>(handle).value == 3);
+  std::unique_ptr<Resource> back =
+      clcxx::convert_to_cpp<std::unique_ptr<Resource>>(handle);
+  CLCXX_CHECK(back.get() == raw);
+  // the handle gave up the ownership
+  CLCXX_CHECK(clcxx::wrapped_box(handle)->foreign.data == nullptr);
+  CLCXX_CHECK(si_get_finalizer(clcxx::wrapped_box(handle)) == ECL_NIL);
+  CLCXX_CHECK_THROWS(clcxx::convert_to_cpp<std::unique_ptr<Resource>>(handle),
+                     std::runtime_error);
+  back.reset();
+  CLCXX_CHECK(Resource::live == 0);
+}
+
+void stateless_deleter() {
+  cl_object handle = clcxx::convert_to_lisp(
+      std::unique_ptr<Resource, CountingDelete>(new Resource()));
+  // another deleter can not take the ownership
+  CLCXX_CHECK_THROWS(clcxx::convert_to_cpp<std::unique_ptr<Resource>>(handle),
+                     std::runtime_error);
+  clcxx::dispose(handle);
+  CLCXX_CHECK(g_deleted == 1);
+  CLCXX_CHECK(Resource::live == 0);
+}
+
+void stateful_deleter() {
+  cl_object handle = clcxx::convert_to_lisp(
+      std::unique_ptr<Resource, TaggedDelete>(new Resource(), TaggedDelete{7}));
+  CLCXX_CHECK(clcxx::convert_to_cpp<Resource &>(handle).value == 3);
+  CLCXX_CHECK((clcxx::convert_to_cpp<
+                   const std::unique_ptr<Resource, TaggedDelete> &>(handle)
+                   .get_deleter()
+                   .tag == 7));
+  {
+    std::unique_ptr<Resource, TaggedDelete> back =
+        clcxx::convert_to_cpp<std::unique_ptr<Resource, TaggedDelete>>(handle);
+    CLCXX_CHECK(back.get_deleter().tag == 7);
+  }
+  CLCXX_CHECK(g_deleted == 2);
+  CLCXX_CHECK(Resource::live == 0);
+  // the handle is left with an empty unique_ptr
+  CLCXX_CHECK_THROWS(clcxx::convert_to_cpp<Resource &>(handle),
+                     std::runtime_error);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Resource>("RESOURCE");
+  round_trip();
+  stateless_deleter();
+  stateful_deleter();
+  return EXIT_SUCCESS;
+}
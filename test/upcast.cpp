@@ -0,0 +1,86 @@
+#include "test_common.hpp"
+
+namespace {
+struct Base {
+  virtual ~Base() {}
+  int base = 1;
+};
+
+struct Other {
+  int other = 2;
+};
+
+// Base is not the first base, so the upcast moves the pointer
+struct Derived : Other, Base {
+  int derived = 3;
+};
+
+struct Leaf : Derived {
+  int leaf = 4;
+};
+
+struct Unrelated {
+  int unrelated = 5;
+};
+
+template <typename T, typename SuperT> void register_base() {
+  clcxx::detail::register_base(ecl_fixnum(clcxx::type_tag<T>()),
+                               ecl_fixnum(clcxx::type_tag<SuperT>()),
+                               clcxx::detail::base_offset<T, SuperT>());
+}
+
+void direct_bases() {
+  cl_object handle = clcxx::create<Derived>();
+  Derived *derived = clcxx::unbox_wrapped_ptr<Derived>(handle);
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Base>(handle) ==
+              static_cast<Base *>(derived));
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Other>(handle) ==
+              static_cast<Other *>(derived));
+  CLCXX_CHECK(clcxx::convert_to_cpp<Base &>(handle).base == 1);
+  clcxx::dispose(handle);
+}
+
+void indirect_bases() {
+  cl_object handle = clcxx::create<Leaf>();
+  Leaf *leaf = clcxx::unbox_wrapped_ptr<Leaf>(handle);
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Derived>(handle) ==
+              static_cast<Derived *>(leaf));
+  CLCXX_CHECK(clcxx::unbox_wrapped_ptr<Base>(handle) ==
+              static_cast<Base *>(leaf));
+  std::ptrdiff_t offset = 0;
+  CLCXX_CHECK(clcxx::detail::upcast_offset(
+      ecl_fixnum(clcxx::type_tag<Leaf>()), ecl_fixnum(clcxx::type_tag<Base>()),
+      offset));
+  CLCXX_CHECK(offset == (clcxx::detail::base_offset<Leaf, Base>()));
+  clcxx::dispose(handle);
+}
+
+void unrelated_types() {
+  cl_object handle = clcxx::create<Derived>();
+  CLCXX_CHECK_THROWS(clcxx::unbox_wrapped_ptr<Unrelated>(handle),
+                     std::runtime_error);
+  std::ptrdiff_t offset = 0;
+  // bases do not upcast to their derived classes
+  CLCXX_CHECK(!clcxx::detail::upcast_offset(
+      ecl_fixnum(clcxx::type_tag<Base>()),
+      ecl_fixnum(clcxx::type_tag<Derived>()), offset));
+  clcxx::dispose(handle);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  clcxx_test::define_class<Base>("BASE");
+  clcxx_test::define_class<Other>("OTHER");
+  clcxx_test::define_class<Derived>("DERIVED");
+  clcxx_test::define_class<Leaf>("LEAF");
+  clcxx_test::define_class<Unrelated>("UNRELATED");
+  register_base<Derived, Other>();
+  register_base<Derived, Base>();
+  // the bases of Derived, registered first, become bases of Leaf
+  register_base<Leaf, Derived>();
+  direct_bases();
+  indirect_bases();
+  unrelated_types();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include "test_common.hpp"
+
+namespace {
+void weak_references() {
+  cl_object obj = ecl_make_simple_base_string("cached", -1);
+  clcxx::WeakLispRef ref(obj);
+  CLCXX_CHECK(ref && ref.get() == obj);
+  CLCXX_CHECK(!ref.expired());
+  // copies share the weak pointer
+  clcxx::WeakLispRef copy = ref;
+  CLCXX_CHECK(copy.get() == obj);
+}
+
+void immediate_references() {
+  // immediates are never collected and are held directly
+  clcxx::WeakLispRef ref(ecl_make_fixnum(12));
+  CLCXX_CHECK(ref.get() == ecl_make_fixnum(12));
+  CLCXX_CHECK(!ref.expired());
+}
+
+void empty_reference() {
+  clcxx::WeakLispRef ref;
+  CLCXX_CHECK(!ref && ref.get() == ECL_NIL);
+  CLCXX_CHECK(!ref.expired());
+}
+
+void weak_key_map() {
+  clcxx::WeakKeyHashMap map;
+  // keys are compared by identity, not by contents
+  cl_object key = ecl_make_simple_base_string("key", -1);
+  cl_object other = ecl_make_simple_base_string("key", -1);
+  map.set(key, ecl_make_fixnum(1));
+  cl_object value = ECL_NIL;
+  CLCXX_CHECK(map.find(key, value) && value == ecl_make_fixnum(1));
+  CLCXX_CHECK(!map.find(other, value));
+  CLCXX_CHECK(map.get(other, ecl_make_fixnum(-1)) == ecl_make_fixnum(-1));
+  map.set(other, ecl_make_fixnum(2));
+  CLCXX_CHECK(map.size() == 2);
+  CLCXX_CHECK(map.erase(key) && !map.erase(key));
+  CLCXX_CHECK(map.size() == 1);
+  map.clear();
+  CLCXX_CHECK(map.size() == 0);
+}
+
+void weak_value_map() {
+  clcxx::WeakValueHashMap map;
+  cl_object value = ecl_make_simple_base_string("value", -1);
+  map.set(ecl_make_fixnum(4096), value);
+  CLCXX_CHECK(map.get(ecl_make_fixnum(4096)) == value);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  clcxx_test::LispRuntime runtime(argc, argv);
+  weak_references();
+  immediate_references();
+  empty_reference();
+  weak_key_map();
+  weak_value_map();
+  return EXIT_SUCCESS;
+}